@@ -0,0 +1,318 @@
+// batchHashImplementation
+// Hashes many keys at once, one key per SIMD lane, so the per-key
+// dependency chain of djb2/sdbm/lose-lose no longer leaves the core idle.
+// Build with AVX2: gcc -O2 -mavx2 batchHashImplementation.c
+// Without -mavx2 the same API falls back to the scalar loops.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define BATCH_LANES 8
+#define BATCH_MAX_LEN 64
+#define BATCH_BLOCK 4096
+
+// Scalar versions, same as djb2HashImplementation.c, sdbmHashImplementation.c
+// and loseLoseHashImplementation.c
+unsigned long djb2_hash(unsigned char *str){
+	unsigned long hash = 5381;
+	int c;
+
+	while((c = *str++)){
+		hash = ((hash << 5) + hash) + c;
+	}
+	return hash;
+}
+
+unsigned long sdbm_hash(unsigned char *str){
+	unsigned long hash = 0;
+	int c;
+
+	while((c = *str++)){
+		hash = c + (hash << 6) + (hash << 16) - hash;
+	}
+	return hash;
+}
+
+unsigned long loselose_hash(unsigned char *str){
+	unsigned int hash = 0;
+	int c;
+
+	while((c = *str++)){
+		hash += c;
+	}
+	return hash;
+}
+
+#if defined(__AVX2__) && (__SIZEOF_LONG__ == 8)
+
+// Next 8 bytes of a key as one little-endian word, zero padded past the
+// end. Short tails re-read the last 8 bytes of the key and shift, so no
+// byte loop is needed unless the whole key is under 8 bytes.
+static unsigned long long batch_word(const unsigned char *p, size_t len, size_t i){
+	unsigned long long w = 0;
+	size_t b;
+
+	if(i + 8 <= len){
+		memcpy(&w, p + i, 8);
+	}else if(len >= 8){
+		memcpy(&w, p + len - 8, 8);
+		w >>= 8 * (8 - (len - i));
+	}else{
+		for(b=i; b<len; b++){
+			w |= (unsigned long long)p[b] << (8 * (b - i));
+		}
+	}
+	return w;
+}
+
+// Words at offset i of 8 keys, four 64-bit lanes per register
+static void batch_words(unsigned char **k, size_t len, size_t i, __m256i *w0, __m256i *w1){
+	*w0 = _mm256_set_epi64x(batch_word(k[3], len, i), batch_word(k[2], len, i),
+		batch_word(k[1], len, i), batch_word(k[0], len, i));
+	*w1 = _mm256_set_epi64x(batch_word(k[7], len, i), batch_word(k[6], len, i),
+		batch_word(k[5], len, i), batch_word(k[4], len, i));
+}
+
+// One group of 8 keys of the same length, one key per 64-bit lane.
+// Bytes are pulled out of the loaded words with vector shifts.
+static void djb2_group(unsigned char **k, size_t len, unsigned long *out){
+	const __m256i low = _mm256_set1_epi64x(0xFF);
+	__m256i h0 = _mm256_set1_epi64x(5381), h1 = h0, w0, w1, c0, c1;
+	size_t i, j, steps;
+
+	for(i=0; i<len; i+=8){
+		batch_words(k, len, i, &w0, &w1);
+		steps = (len - i < 8) ? len - i : 8;
+		for(j=0; j<steps; j++){
+			c0 = _mm256_and_si256(_mm256_srli_epi64(w0, 8 * j), low);
+			c1 = _mm256_and_si256(_mm256_srli_epi64(w1, 8 * j), low);
+			h0 = _mm256_add_epi64(_mm256_add_epi64(_mm256_slli_epi64(h0, 5), h0), c0);
+			h1 = _mm256_add_epi64(_mm256_add_epi64(_mm256_slli_epi64(h1, 5), h1), c1);
+		}
+	}
+	_mm256_storeu_si256((__m256i *)&out[0], h0);
+	_mm256_storeu_si256((__m256i *)&out[4], h1);
+}
+
+static void sdbm_group(unsigned char **k, size_t len, unsigned long *out){
+	const __m256i low = _mm256_set1_epi64x(0xFF);
+	__m256i h0 = _mm256_setzero_si256(), h1 = h0, w0, w1, c0, c1;
+	size_t i, j, steps;
+
+	for(i=0; i<len; i+=8){
+		batch_words(k, len, i, &w0, &w1);
+		steps = (len - i < 8) ? len - i : 8;
+		for(j=0; j<steps; j++){
+			c0 = _mm256_and_si256(_mm256_srli_epi64(w0, 8 * j), low);
+			c1 = _mm256_and_si256(_mm256_srli_epi64(w1, 8 * j), low);
+			h0 = _mm256_sub_epi64(_mm256_add_epi64(_mm256_add_epi64(c0, _mm256_slli_epi64(h0, 6)), _mm256_slli_epi64(h0, 16)), h0);
+			h1 = _mm256_sub_epi64(_mm256_add_epi64(_mm256_add_epi64(c1, _mm256_slli_epi64(h1, 6)), _mm256_slli_epi64(h1, 16)), h1);
+		}
+	}
+	_mm256_storeu_si256((__m256i *)&out[0], h0);
+	_mm256_storeu_si256((__m256i *)&out[4], h1);
+}
+
+// lose-lose is a plain byte sum and the padding is 0, so the 8 bytes of
+// each word are summed at once with vpsadbw
+static void loselose_group(unsigned char **k, size_t len, unsigned long *out){
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i h0 = zero, h1 = zero, w0, w1;
+	size_t i;
+
+	for(i=0; i<len; i+=8){
+		batch_words(k, len, i, &w0, &w1);
+		h0 = _mm256_add_epi64(h0, _mm256_sad_epu8(w0, zero));
+		h1 = _mm256_add_epi64(h1, _mm256_sad_epu8(w1, zero));
+	}
+	_mm256_storeu_si256((__m256i *)&out[0], h0);
+	_mm256_storeu_si256((__m256i *)&out[4], h1);
+	for(i=0; i<BATCH_LANES; i++){
+		out[i] = (unsigned int)out[i];
+	}
+}
+
+#else
+
+// Scalar groups hash exactly len bytes of each key, as the SIMD path does
+static void djb2_group(unsigned char **k, size_t len, unsigned long *out){
+	unsigned long hash;
+	size_t i, j;
+	for(i=0; i<BATCH_LANES; i++){
+		hash = 5381;
+		for(j=0; j<len; j++){
+			hash = ((hash << 5) + hash) + k[i][j];
+		}
+		out[i] = hash;
+	}
+}
+
+static void sdbm_group(unsigned char **k, size_t len, unsigned long *out){
+	unsigned long hash;
+	size_t i, j;
+	for(i=0; i<BATCH_LANES; i++){
+		hash = 0;
+		for(j=0; j<len; j++){
+			hash = k[i][j] + (hash << 6) + (hash << 16) - hash;
+		}
+		out[i] = hash;
+	}
+}
+
+static void loselose_group(unsigned char **k, size_t len, unsigned long *out){
+	unsigned int hash;
+	size_t i, j;
+	for(i=0; i<BATCH_LANES; i++){
+		hash = 0;
+		for(j=0; j<len; j++){
+			hash += k[i][j];
+		}
+		out[i] = hash;
+	}
+}
+
+#endif
+
+// Keys are bucketed by length first so that all 8 lanes of a group finish
+// together: no masking and no lanes idling behind the longest key.
+// Bucketing is done per block of BATCH_BLOCK keys so the keys are still
+// visited roughly in memory order. Keys longer than BATCH_MAX_LEN and the
+// few left over in each bucket go through the scalar function.
+static void batch_block(unsigned char **keys, size_t n, unsigned long *out,
+		void (*group)(unsigned char **, size_t, unsigned long *),
+		unsigned long (*scalar)(unsigned char *)){
+	unsigned short count[BATCH_MAX_LEN + 3] = {0};
+	unsigned short order[BATCH_BLOCK];
+	unsigned char lens[BATCH_BLOCK];
+	unsigned char *k[BATCH_LANES];
+	unsigned long h[BATCH_LANES];
+	size_t i, j, len, start, end;
+
+	for(i=0; i<n; i++){
+		len = strlen((char *)keys[i]);
+		lens[i] = (len > BATCH_MAX_LEN) ? BATCH_MAX_LEN + 1 : len;
+		count[lens[i] + 1]++;
+	}
+	for(len=1; len<BATCH_MAX_LEN+3; len++){
+		count[len] += count[len-1];
+	}
+	for(i=0; i<n; i++){
+		order[count[lens[i]]++] = i;
+	}
+
+	//bucket len now ends at count[len] and starts where bucket len-1 ended
+	start = 0;
+	for(len=0; len<=BATCH_MAX_LEN+1; len++){
+		end = count[len];
+		i = start;
+		if(len <= BATCH_MAX_LEN){
+			for(; i + BATCH_LANES <= end; i += BATCH_LANES){
+				for(j=0; j<BATCH_LANES; j++){
+					k[j] = keys[order[i + j]];
+				}
+				group(k, len, h);
+				for(j=0; j<BATCH_LANES; j++){
+					out[order[i + j]] = h[j];
+				}
+			}
+		}
+		for(; i<end; i++){
+			out[order[i]] = scalar(keys[order[i]]);
+		}
+		start = end;
+	}
+}
+
+static void batch_run(unsigned char **keys, size_t n, unsigned long *out,
+		void (*group)(unsigned char **, size_t, unsigned long *),
+		unsigned long (*scalar)(unsigned char *)){
+	size_t i;
+
+	for(i=0; i<n; i+=BATCH_BLOCK){
+		batch_block(keys + i, (n - i < BATCH_BLOCK) ? n - i : BATCH_BLOCK, out + i, group, scalar);
+	}
+}
+
+// Batch API: hash n NUL-terminated keys into out[0..n-1]
+void djb2_hash_batch(unsigned char **keys, size_t n, unsigned long *out){
+	batch_run(keys, n, out, djb2_group, djb2_hash);
+}
+
+void sdbm_hash_batch(unsigned char **keys, size_t n, unsigned long *out){
+	batch_run(keys, n, out, sdbm_group, sdbm_hash);
+}
+
+void loselose_hash_batch(unsigned char **keys, size_t n, unsigned long *out){
+	batch_run(keys, n, out, loselose_group, loselose_hash);
+}
+
+//benchmark: keys/sec of the batch API against the scalar loop
+static double seconds(clock_t start){
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void bench(const char *name, unsigned long (*scalar)(unsigned char *),
+		void (*batch)(unsigned char **, size_t, unsigned long *),
+		unsigned char **keys, size_t n, unsigned long *a, unsigned long *b){
+	size_t i, bad = 0;
+	clock_t start;
+	double ts, tb;
+
+	start = clock();
+	for(i=0; i<n; i++){
+		a[i] = scalar(keys[i]);
+	}
+	ts = seconds(start);
+
+	start = clock();
+	batch(keys, n, b);
+	tb = seconds(start);
+
+	for(i=0; i<n; i++){
+		if(a[i] != b[i]){
+			bad++;
+		}
+	}
+	printf("%-9s scalar %8.2f Mkeys/s  batch %8.2f Mkeys/s  mismatches %lu\n",
+		name, n / ts / 1e6, n / tb / 1e6, (unsigned long)bad);
+}
+
+int main(int argc, char **argv){
+	size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 2000000;
+	size_t i, j, len;
+	unsigned char **keys = malloc(n * sizeof(*keys));
+	unsigned long *a = malloc(n * sizeof(*a));
+	unsigned long *b = malloc(n * sizeof(*b));
+
+	if(keys == NULL || a == NULL || b == NULL){
+		return 1;
+	}
+	srand(1);
+	//short keys, 4 to 24 printable characters
+	for(i=0; i<n; i++){
+		len = 4 + rand() % 21;
+		keys[i] = malloc(len + 1);
+		for(j=0; j<len; j++){
+			keys[i][j] = 'a' + rand() % 26;
+		}
+		keys[i][len] = 0;
+	}
+
+	printf("%lu keys\n", (unsigned long)n);
+	bench("djb2", djb2_hash, djb2_hash_batch, keys, n, a, b);
+	bench("sdbm", sdbm_hash, sdbm_hash_batch, keys, n, a, b);
+	bench("loselose", loselose_hash, loselose_hash_batch, keys, n, a, b);
+
+	for(i=0; i<n; i++){
+		free(keys[i]);
+	}
+	free(keys);
+	free(a);
+	free(b);
+	return 0;
+}
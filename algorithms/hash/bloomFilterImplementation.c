@@ -0,0 +1,258 @@
+// bloomFilterImplementation
+// Blocked Bloom filter. All k bits of a key live in one 512-bit block, a
+// single cache line, so an insert or query touches one line instead of k.
+// The k bit positions come from Kirsch-Mitzenmacher double hashing,
+// g_i = h1 + i*h2, with djb2 and sdbm as the two base hashes.
+// Batch insert/query hash a run of keys and prefetch their blocks first so
+// the cache misses overlap. Filters with the same size merge with OR, so
+// shards can be built in parallel and combined.
+// main() measures false positive rate against bits per key.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define BLOCK_BITS 512
+#define BLOCK_WORDS (BLOCK_BITS / 64)
+#define BATCH 16
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+
+typedef struct bloom{
+	unsigned long long *bits;	// nblocks * BLOCK_WORDS words
+	size_t nblocks;
+	int k;
+} bloom_t;
+
+// djb2HashImplementation.c and sdbmHashImplementation.c
+unsigned long djb2_hash(unsigned char *str){
+	unsigned long hash = 5381;
+	int c;
+
+	while((c = *str++)){
+		hash = ((hash << 5) + hash) + c;
+	}
+	return hash;
+}
+
+unsigned long sdbm_hash(unsigned char *str){
+	unsigned long hash = 0;
+	int c;
+
+	while((c = *str++)){
+		hash = c + (hash << 6) + (hash << 16) - hash;
+	}
+	return hash;
+}
+
+// Spread the base hashes over 64 bits, djb2 and sdbm leave the high bits
+// of short keys nearly constant
+static unsigned long long mix64(unsigned long long x){
+	x ^= x >> 33;
+	x *= 0xFF51AFD7ED558CCDULL;
+	x ^= x >> 33;
+	x *= 0xC4CEB9FE1A85EC53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+typedef struct key_hash{
+	unsigned long long h1, h2;
+} key_hash_t;
+
+static key_hash_t bloom_hash(const char *key){
+	key_hash_t h;
+	h.h1 = mix64(djb2_hash((unsigned char *)key));
+	h.h2 = mix64(sdbm_hash((unsigned char *)key)) | 1;
+	return h;
+}
+
+int bloom_init(bloom_t *b, size_t n, double bits_per_key){
+	b->nblocks = (size_t)ceil(n * bits_per_key / BLOCK_BITS);
+	if(b->nblocks == 0){
+		b->nblocks = 1;
+	}
+	//k = bits_per_key * ln 2 is optimal for a plain Bloom filter
+	b->k = (int)(bits_per_key * 0.693 + 0.5);
+	if(b->k < 1){
+		b->k = 1;
+	}
+	if(b->k > 16){
+		b->k = 16;
+	}
+	b->bits = calloc(b->nblocks * BLOCK_WORDS, sizeof(*b->bits));
+	return (b->bits == NULL) ? -1 : 0;
+}
+
+void bloom_free(bloom_t *b){
+	free(b->bits);
+	b->bits = NULL;
+}
+
+static unsigned long long *bloom_block(const bloom_t *b, key_hash_t h){
+	return b->bits + (size_t)((h.h1 >> 32) % b->nblocks) * BLOCK_WORDS;
+}
+
+static void bloom_set(const bloom_t *b, key_hash_t h){
+	unsigned long long *block = bloom_block(b, h);
+	unsigned long long g = h.h1;
+	int i;
+
+	for(i=0; i<b->k; i++){
+		block[(g >> 6) & (BLOCK_WORDS - 1)] |= 1ULL << (g & 63);
+		g += h.h2;
+	}
+}
+
+static int bloom_test(const bloom_t *b, key_hash_t h){
+	const unsigned long long *block = bloom_block(b, h);
+	unsigned long long g = h.h1;
+	int i;
+
+	for(i=0; i<b->k; i++){
+		if(!(block[(g >> 6) & (BLOCK_WORDS - 1)] & (1ULL << (g & 63)))){
+			return 0;
+		}
+		g += h.h2;
+	}
+	return 1;
+}
+
+void bloom_add(bloom_t *b, const char *key){
+	bloom_set(b, bloom_hash(key));
+}
+
+// 1 if key may be in the set, 0 if it is certainly not
+int bloom_contains(const bloom_t *b, const char *key){
+	return bloom_test(b, bloom_hash(key));
+}
+
+void bloom_add_batch(bloom_t *b, char **keys, size_t n){
+	key_hash_t h[BATCH];
+	size_t i, j, m;
+
+	for(i=0; i<n; i+=BATCH){
+		m = (n - i < BATCH) ? n - i : BATCH;
+		for(j=0; j<m; j++){
+			h[j] = bloom_hash(keys[i + j]);
+			PREFETCH(bloom_block(b, h[j]));
+		}
+		for(j=0; j<m; j++){
+			bloom_set(b, h[j]);
+		}
+	}
+}
+
+void bloom_contains_batch(const bloom_t *b, char **keys, size_t n, unsigned char *out){
+	key_hash_t h[BATCH];
+	size_t i, j, m;
+
+	for(i=0; i<n; i+=BATCH){
+		m = (n - i < BATCH) ? n - i : BATCH;
+		for(j=0; j<m; j++){
+			h[j] = bloom_hash(keys[i + j]);
+			PREFETCH(bloom_block(b, h[j]));
+		}
+		for(j=0; j<m; j++){
+			out[i + j] = (unsigned char)bloom_test(b, h[j]);
+		}
+	}
+}
+
+// dst |= src. Both must have been created with the same size and k.
+int bloom_merge(bloom_t *dst, const bloom_t *src){
+	size_t i;
+
+	if(dst->nblocks != src->nblocks || dst->k != src->k){
+		return -1;
+	}
+	for(i=0; i<dst->nblocks * BLOCK_WORDS; i++){
+		dst->bits[i] |= src->bits[i];
+	}
+	return 0;
+}
+
+//benchmark: false positive rate and throughput against bits per key
+static char **make_keys(const char *prefix, size_t n){
+	char **keys = malloc(n * sizeof(*keys));
+	char *buf = malloc(n * 24);
+	size_t i;
+
+	for(i=0; i<n; i++){
+		keys[i] = buf + i * 24;
+		sprintf(keys[i], "%s%lu", prefix, (unsigned long)i);
+	}
+	return keys;
+}
+
+static void free_keys(char **keys){
+	free(keys[0]);
+	free(keys);
+}
+
+int main(int argc, char **argv){
+	size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+	double bpk[] = {4, 6, 8, 10, 12, 16, 20};
+	char **in = make_keys("user:", n);
+	char **out = make_keys("guest:", n);
+	unsigned char *hit = malloc(n);
+	bloom_t b, shard;
+	size_t i, fp, missed;
+	int t, k;
+	clock_t start;
+	double ti, tq, plain;
+
+	printf("%lu keys inserted, %lu absent keys queried\n", (unsigned long)n, (unsigned long)n);
+	printf("bits/key   k   false positives   plain bloom   insert Mkeys/s   query Mkeys/s\n");
+	for(t=0; t<(int)(sizeof(bpk) / sizeof(bpk[0])); t++){
+		if(bloom_init(&b, n, bpk[t]) != 0){
+			return 1;
+		}
+		start = clock();
+		bloom_add_batch(&b, in, n);
+		ti = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		start = clock();
+		bloom_contains_batch(&b, out, n, hit);
+		tq = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		for(i=0, fp=0; i<n; i++){
+			fp += hit[i];
+		}
+		bloom_contains_batch(&b, in, n, hit);
+		for(i=0, missed=0; i<n; i++){
+			missed += !hit[i];
+		}
+		k = b.k;
+		plain = pow(1.0 - exp(-k / bpk[t]), k);
+		printf("%8.0f  %2d   %14.4f%%  %11.4f%%   %14.2f   %13.2f%s\n", bpk[t], k,
+			100.0 * fp / n, 100.0 * plain, n / ti / 1e6, n / tq / 1e6,
+			missed ? "  FALSE NEGATIVES" : "");
+		bloom_free(&b);
+	}
+
+	//two shards built separately then merged answer like one filter
+	bloom_init(&b, n, 10);
+	bloom_init(&shard, n, 10);
+	bloom_add_batch(&b, in, n / 2);
+	bloom_add_batch(&shard, in + n / 2, n - n / 2);
+	bloom_merge(&b, &shard);
+	bloom_contains_batch(&b, in, n, hit);
+	for(i=0, missed=0; i<n; i++){
+		missed += !hit[i];
+	}
+	printf("merged shards: %lu false negatives\n", (unsigned long)missed);
+	bloom_free(&b);
+	bloom_free(&shard);
+
+	free(hit);
+	free_keys(in);
+	free_keys(out);
+	return 0;
+}
@@ -0,0 +1,532 @@
+// concurrentHashTableImplementation
+// Concurrent hash map for multi-threaded ingest.
+//  - Reads are lock-free: a reader walks a bucket chain of atomic pointers
+//    and never waits for a writer.
+//  - Writes are fine-grained: a writer takes one of 1024 spinlocks chosen
+//    by the low bits of the hash, so writers on different stripes never
+//    contend. Updating the value of an existing key is one atomic store.
+//  - Growth takes every stripe lock, copies the chains into a new bucket
+//    array and publishes it with one atomic store; readers still on the
+//    old array see it unchanged.
+//  - Removed nodes and old arrays are freed by epoch based reclamation:
+//    they are only freed once every thread has left the epoch in which
+//    they were unlinked, so a reader never touches freed memory.
+// The hash function is pluggable, djb2 by default.
+// main() checks concurrent inserts and prints throughput from 1 to N
+// threads for read-heavy and write-heavy mixes.
+// To run: gcc -O2 -pthread concurrentHashTableImplementation.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define STRIPES 1024		// power of two, at most the smallest bucket count
+#define MAX_THREADS 128
+#define RETIRE_SCAN 64		// retired objects per thread before trying to free some
+
+typedef unsigned long (*hash_fn)(unsigned char *str);
+
+typedef struct cnode{
+	_Atomic(struct cnode *) next;
+	atomic_long val;
+	unsigned long hash;
+	char key[];
+} cnode_t;
+
+typedef struct ctable{
+	size_t capacity;	// power of two
+	_Atomic(cnode_t *) buckets[];
+} ctable_t;
+
+typedef struct retired{
+	void *ptr;
+	void (*release)(void *);
+	unsigned long epoch;
+} retired_t;
+
+// Per-thread epoch record, padded so threads do not share cache lines
+typedef struct thread_rec{
+	atomic_ulong epoch;
+	atomic_int active;
+	retired_t *retired;
+	size_t nretired, cap;
+	char pad[64];
+} thread_rec_t;
+
+typedef struct cmap{
+	_Atomic(ctable_t *) table;
+	atomic_flag locks[STRIPES];
+	atomic_size_t size;
+	atomic_ulong epoch;
+	atomic_int threads;
+	thread_rec_t rec[MAX_THREADS];
+	hash_fn hash;
+} cmap_t;
+
+// djb2HashImplementation.c and sdbmHashImplementation.c
+unsigned long djb2_hash(unsigned char *str){
+	unsigned long hash = 5381;
+	int c;
+
+	while((c = *str++)){
+		hash = ((hash << 5) + hash) + c;
+	}
+	return hash;
+}
+
+unsigned long sdbm_hash(unsigned char *str){
+	unsigned long hash = 0;
+	int c;
+
+	while((c = *str++)){
+		hash = c + (hash << 6) + (hash << 16) - hash;
+	}
+	return hash;
+}
+
+// Spread the hash so both the stripe and the bucket bits are well mixed
+static unsigned long cmap_mix(unsigned long h){
+	unsigned long long m = (unsigned long long)h * 0x9E3779B97F4A7C15ULL;
+	return (unsigned long)(m ^ (m >> 29));
+}
+
+//epoch based reclamation
+static void epoch_enter(cmap_t *m, int tid){
+	thread_rec_t *r = &m->rec[tid];
+	atomic_store(&r->active, 1);
+	atomic_store(&r->epoch, atomic_load(&m->epoch));
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+static void epoch_leave(cmap_t *m, int tid){
+	atomic_store_explicit(&m->rec[tid].active, 0, memory_order_release);
+}
+
+// The global epoch moves on once every active thread has seen it.
+// Anything retired two epochs back can no longer be reached.
+static void epoch_collect(cmap_t *m, int tid){
+	thread_rec_t *r = &m->rec[tid];
+	unsigned long e = atomic_load(&m->epoch);
+	int i, n = atomic_load(&m->threads);
+	size_t j, keep = 0;
+
+	if(n > MAX_THREADS){
+		n = MAX_THREADS;
+	}
+	for(i=0; i<n; i++){
+		if(atomic_load(&m->rec[i].active) && atomic_load(&m->rec[i].epoch) != e){
+			break;
+		}
+	}
+	if(i == n){
+		atomic_compare_exchange_strong(&m->epoch, &e, e + 1);
+		e = atomic_load(&m->epoch);
+	}
+	for(j=0; j<r->nretired; j++){
+		if(r->retired[j].epoch + 2 <= e){
+			r->retired[j].release(r->retired[j].ptr);
+		}else{
+			r->retired[keep++] = r->retired[j];
+		}
+	}
+	r->nretired = keep;
+}
+
+static void epoch_retire(cmap_t *m, int tid, void *ptr, void (*release)(void *)){
+	thread_rec_t *r = &m->rec[tid];
+
+	if(r->nretired == r->cap){
+		r->cap = r->cap ? r->cap * 2 : RETIRE_SCAN;
+		r->retired = realloc(r->retired, r->cap * sizeof(*r->retired));
+	}
+	r->retired[r->nretired].ptr = ptr;
+	r->retired[r->nretired].release = release;
+	r->retired[r->nretired].epoch = atomic_load(&m->epoch);
+	r->nretired++;
+	if(r->nretired % RETIRE_SCAN == 0){
+		epoch_collect(m, tid);
+	}
+}
+
+// Frees an old bucket array and the nodes that were copied out of it
+static void table_release(void *p){
+	ctable_t *t = p;
+	cnode_t *n, *next;
+	size_t i;
+
+	for(i=0; i<t->capacity; i++){
+		for(n=atomic_load_explicit(&t->buckets[i], memory_order_relaxed); n!=NULL; n=next){
+			next = atomic_load_explicit(&n->next, memory_order_relaxed);
+			free(n);
+		}
+	}
+	free(t);
+}
+
+static ctable_t *table_new(size_t capacity){
+	ctable_t *t = calloc(1, sizeof(ctable_t) + capacity * sizeof(t->buckets[0]));
+	if(t != NULL){
+		t->capacity = capacity;
+	}
+	return t;
+}
+
+// Spin, but give the core away if the holder seems to have been preempted
+static void stripe_lock(cmap_t *m, size_t s){
+	int spins = 0;
+	while(atomic_flag_test_and_set_explicit(&m->locks[s], memory_order_acquire)){
+		if(++spins == 64){
+			sched_yield();
+			spins = 0;
+		}
+	}
+}
+
+static void stripe_unlock(cmap_t *m, size_t s){
+	atomic_flag_clear_explicit(&m->locks[s], memory_order_release);
+}
+
+int cmap_init(cmap_t *m, size_t capacity, hash_fn hash){
+	size_t cap = STRIPES, i;
+	ctable_t *t;
+
+	while(cap < capacity){
+		cap <<= 1;
+	}
+	t = table_new(cap);
+	if(t == NULL){
+		return -1;
+	}
+	memset(m->rec, 0, sizeof(m->rec));
+	atomic_init(&m->table, t);
+	atomic_init(&m->size, 0);
+	atomic_init(&m->epoch, 0);
+	atomic_init(&m->threads, 0);
+	for(i=0; i<STRIPES; i++){
+		atomic_flag_clear(&m->locks[i]);
+	}
+	m->hash = hash;
+	return 0;
+}
+
+// Every thread using the map registers once and passes the id it gets back
+// to every other call. Returns -1 once MAX_THREADS threads have registered;
+// the caller must not use the map from that thread. A failed call does not
+// use up a slot.
+int cmap_register(cmap_t *m){
+	int tid = atomic_load(&m->threads);
+
+	do{
+		if(tid >= MAX_THREADS){
+			return -1;
+		}
+	}while(!atomic_compare_exchange_weak(&m->threads, &tid, tid + 1));
+	return tid;
+}
+
+// Only call once no other thread is using the map
+void cmap_free(cmap_t *m){
+	int i;
+	size_t j;
+
+	for(i=0; i<atomic_load(&m->threads) && i<MAX_THREADS; i++){
+		for(j=0; j<m->rec[i].nretired; j++){
+			m->rec[i].retired[j].release(m->rec[i].retired[j].ptr);
+		}
+		free(m->rec[i].retired);
+	}
+	table_release(atomic_load(&m->table));
+}
+
+// Lock-free lookup. Returns 1 and stores the value if key is present.
+int cmap_get(cmap_t *m, int tid, const char *key, long *val){
+	unsigned long h = cmap_mix(m->hash((unsigned char *)key));
+	ctable_t *t;
+	cnode_t *n;
+	int found = 0;
+
+	epoch_enter(m, tid);
+	t = atomic_load_explicit(&m->table, memory_order_acquire);
+	n = atomic_load_explicit(&t->buckets[h & (t->capacity - 1)], memory_order_acquire);
+	for(; n!=NULL; n=atomic_load_explicit(&n->next, memory_order_acquire)){
+		if(n->hash == h && strcmp(n->key, key) == 0){
+			if(val != NULL){
+				*val = atomic_load_explicit(&n->val, memory_order_relaxed);
+			}
+			found = 1;
+			break;
+		}
+	}
+	epoch_leave(m, tid);
+	return found;
+}
+
+// Double the bucket array once the average chain passes 1
+static void cmap_grow(cmap_t *m, int tid, ctable_t *seen){
+	ctable_t *old, *t;
+	cnode_t *n, *copy;
+	size_t i, len;
+
+	for(i=0; i<STRIPES; i++){
+		stripe_lock(m, i);
+	}
+	old = atomic_load(&m->table);
+	if(old == seen && (t = table_new(old->capacity * 2)) != NULL){
+		for(i=0; i<old->capacity; i++){
+			for(n=atomic_load(&old->buckets[i]); n!=NULL; n=atomic_load(&n->next)){
+				len = strlen(n->key) + 1;
+				copy = malloc(sizeof(cnode_t) + len);
+				if(copy == NULL){
+					break;
+				}
+				memcpy(copy->key, n->key, len);
+				copy->hash = n->hash;
+				atomic_init(&copy->val, atomic_load(&n->val));
+				atomic_init(&copy->next, atomic_load(&t->buckets[n->hash & (t->capacity - 1)]));
+				atomic_init(&t->buckets[n->hash & (t->capacity - 1)], copy);
+			}
+			if(n != NULL){
+				break;
+			}
+		}
+		if(i == old->capacity){
+			atomic_store_explicit(&m->table, t, memory_order_release);
+			epoch_retire(m, tid, old, table_release);
+		}else{
+			table_release(t);
+		}
+	}
+	for(i=0; i<STRIPES; i++){
+		stripe_unlock(m, i);
+	}
+}
+
+// Insert or update. The key is copied into the node.
+int cmap_put(cmap_t *m, int tid, const char *key, long val){
+	unsigned long h = cmap_mix(m->hash((unsigned char *)key));
+	size_t s = h & (STRIPES - 1), len;
+	ctable_t *t;
+	_Atomic(cnode_t *) *head;
+	cnode_t *n;
+	int grow = 0;
+
+	epoch_enter(m, tid);
+	stripe_lock(m, s);
+	t = atomic_load(&m->table);
+	head = &t->buckets[h & (t->capacity - 1)];
+	for(n=atomic_load(head); n!=NULL; n=atomic_load(&n->next)){
+		if(n->hash == h && strcmp(n->key, key) == 0){
+			atomic_store_explicit(&n->val, val, memory_order_relaxed);
+			break;
+		}
+	}
+	if(n == NULL){
+		len = strlen(key) + 1;
+		n = malloc(sizeof(cnode_t) + len);
+		if(n == NULL){
+			stripe_unlock(m, s);
+			epoch_leave(m, tid);
+			return -1;
+		}
+		memcpy(n->key, key, len);
+		n->hash = h;
+		atomic_init(&n->val, val);
+		atomic_init(&n->next, atomic_load(head));
+		//release: a reader that sees the node also sees its contents
+		atomic_store_explicit(head, n, memory_order_release);
+		grow = atomic_fetch_add(&m->size, 1) + 1 > t->capacity;
+	}
+	stripe_unlock(m, s);
+	if(grow){
+		cmap_grow(m, tid, t);
+	}
+	epoch_leave(m, tid);
+	return 0;
+}
+
+// Returns 1 if key was removed
+int cmap_remove(cmap_t *m, int tid, const char *key){
+	unsigned long h = cmap_mix(m->hash((unsigned char *)key));
+	size_t s = h & (STRIPES - 1);
+	ctable_t *t;
+	_Atomic(cnode_t *) *link;
+	cnode_t *n;
+
+	epoch_enter(m, tid);
+	stripe_lock(m, s);
+	t = atomic_load(&m->table);
+	link = &t->buckets[h & (t->capacity - 1)];
+	for(n=atomic_load(link); n!=NULL; n=atomic_load(link)){
+		if(n->hash == h && strcmp(n->key, key) == 0){
+			atomic_store_explicit(link, atomic_load(&n->next), memory_order_release);
+			atomic_fetch_sub(&m->size, 1);
+			break;
+		}
+		link = &n->next;
+	}
+	stripe_unlock(m, s);
+	if(n != NULL){
+		epoch_retire(m, tid, n, free);
+	}
+	epoch_leave(m, tid);
+	return n != NULL;
+}
+
+//benchmark
+typedef struct worker{
+	cmap_t *map;
+	char **keys;
+	size_t nkeys, ops, start;
+	int write_pct;
+	int failed;		// set if the thread could not register
+	long checksum;
+} worker_t;
+
+static void *run_mix(void *arg){
+	worker_t *w = arg;
+	int tid = cmap_register(w->map);
+	unsigned long long x = 88172645463325252ULL + w->start;
+	size_t i, k;
+	long v;
+
+	if(tid < 0){
+		w->failed = 1;
+		return NULL;
+	}
+	for(i=0; i<w->ops; i++){
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		k = (size_t)(x % w->nkeys);
+		if((int)(x >> 40) % 100 < w->write_pct){
+			if(x & (1ULL << 32)){
+				cmap_put(w->map, tid, w->keys[k], (long)i);
+			}else{
+				cmap_remove(w->map, tid, w->keys[k]);
+			}
+		}else if(cmap_get(w->map, tid, w->keys[k], &v)){
+			w->checksum += v;
+		}
+	}
+	return NULL;
+}
+
+static void *run_insert(void *arg){
+	worker_t *w = arg;
+	int tid = cmap_register(w->map);
+	size_t i;
+
+	if(tid < 0){
+		w->failed = 1;
+		return NULL;
+	}
+	for(i=w->start; i<w->start+w->ops; i++){
+		cmap_put(w->map, tid, w->keys[i], (long)i);
+	}
+	return NULL;
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv){
+	int maxthreads = (argc > 1) ? atoi(argv[1]) : 8;
+	size_t nkeys = (argc > 2) ? strtoul(argv[2], NULL, 10) : 1000000;
+	size_t ops = 2000000, i, missing = 0;
+	char *buf = malloc(nkeys * 16);
+	char **keys = malloc(nkeys * sizeof(*keys));
+	static cmap_t map;
+	pthread_t th[MAX_THREADS];
+	worker_t w[MAX_THREADS];
+	int mixes[] = {5, 50};
+	int t, mix, tid, failed;
+	double start, sec;
+	long v;
+
+	//main registers with each map too, so one slot is left for it
+	if(buf == NULL || keys == NULL || maxthreads < 1 || maxthreads > MAX_THREADS - 1){
+		return 1;
+	}
+	for(i=0; i<nkeys; i++){
+		keys[i] = buf + i * 16;
+		sprintf(keys[i], "key%lu", (unsigned long)i);
+	}
+
+	//concurrent inserts of disjoint ranges, starting small to force growth
+	cmap_init(&map, 0, djb2_hash);
+	for(t=0; t<maxthreads; t++){
+		w[t].map = &map;
+		w[t].keys = keys;
+		w[t].start = nkeys / maxthreads * t;
+		w[t].ops = (t == maxthreads - 1) ? nkeys - w[t].start : nkeys / maxthreads;
+		w[t].failed = 0;
+		pthread_create(&th[t], NULL, run_insert, &w[t]);
+	}
+	for(t=0, failed=0; t<maxthreads; t++){
+		pthread_join(th[t], NULL);
+		failed |= w[t].failed;
+	}
+	tid = cmap_register(&map);
+	if(failed || tid < 0){
+		printf("Could not register every thread\n");
+		return 1;
+	}
+	for(i=0; i<nkeys; i++){
+		if(!cmap_get(&map, tid, keys[i], &v) || v != (long)i){
+			missing++;
+		}
+	}
+	printf("%d threads inserted %lu keys: size %lu, %lu missing\n", maxthreads,
+		(unsigned long)nkeys, (unsigned long)atomic_load(&map.size), (unsigned long)missing);
+	cmap_free(&map);
+
+	for(mix=0; mix<2; mix++){
+		printf("%d%% writes\n", mixes[mix]);
+		for(t=1; t<=maxthreads; t*=2){
+			int n;
+			cmap_init(&map, nkeys, djb2_hash);
+			tid = cmap_register(&map);
+			if(tid < 0){
+				printf("Could not register\n");
+				return 1;
+			}
+			for(i=0; i<nkeys; i++){
+				cmap_put(&map, tid, keys[i], (long)i);
+			}
+			start = now();
+			for(n=0; n<t; n++){
+				w[n].map = &map;
+				w[n].keys = keys;
+				w[n].nkeys = nkeys;
+				w[n].ops = ops;
+				w[n].start = n;
+				w[n].write_pct = mixes[mix];
+				w[n].checksum = 0;
+				w[n].failed = 0;
+				pthread_create(&th[n], NULL, run_mix, &w[n]);
+			}
+			for(n=0, failed=0; n<t; n++){
+				pthread_join(th[n], NULL);
+				failed |= w[n].failed;
+			}
+			sec = now() - start;
+			if(failed){
+				printf("Could not register every thread\n");
+				return 1;
+			}
+			printf("  %3d threads  %8.2f Mops/s\n", t, ops * t / sec / 1e6);
+			cmap_free(&map);
+		}
+	}
+
+	free(buf);
+	free(keys);
+	return 0;
+}
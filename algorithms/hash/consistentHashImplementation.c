@@ -0,0 +1,356 @@
+// consistentHashImplementation
+// Consistent hashing for sharding keys across workers. With hash % N,
+// going from N to N+1 workers moves about N/(N+1) of all keys; here only
+// the keys the new worker takes over move, about 1/(N+1) of them.
+//  - Ring: each worker puts `vnodes` points on a 64-bit circle, and a key
+//    belongs to the first point at or after its hash. More points per
+//    worker give a more even split. Any worker can be added or removed. A
+//    bucket index over the top bits of the circle finds the right point
+//    in O(1) expected time instead of a binary search.
+//  - Jump consistent hash (Lamping and Veach): no memory and O(log N)
+//    time, but workers are numbered 0..N-1 and only the last one can be
+//    removed.
+// Keys are hashed with djb2 or sdbm, then mixed, since both keep the last
+// bytes of the key in their low bits.
+// main() measures lookup throughput, load balance and key movement.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define BATCH 16
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+
+typedef unsigned long (*hash_fn)(unsigned char *str);
+
+typedef struct ring_point{
+	unsigned long long hash;
+	int worker;
+} ring_point_t;
+
+typedef struct hash_ring{
+	ring_point_t *points;	// sorted by hash
+	size_t npoints, cap;
+	unsigned int *index;	// first point at or after each bucket start
+	int index_shift;	// bucket of h is h >> index_shift
+	int vnodes;
+	hash_fn hash;
+} hash_ring_t;
+
+// djb2HashImplementation.c and sdbmHashImplementation.c
+unsigned long djb2_hash(unsigned char *str){
+	unsigned long hash = 5381;
+	int c;
+
+	while((c = *str++)){
+		hash = ((hash << 5) + hash) + c;
+	}
+	return hash;
+}
+
+unsigned long sdbm_hash(unsigned char *str){
+	unsigned long hash = 0;
+	int c;
+
+	while((c = *str++)){
+		hash = c + (hash << 6) + (hash << 16) - hash;
+	}
+	return hash;
+}
+
+static unsigned long long mix64(unsigned long long x){
+	x ^= x >> 33;
+	x *= 0xFF51AFD7ED558CCDULL;
+	x ^= x >> 33;
+	x *= 0xC4CEB9FE1A85EC53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static unsigned long long key_hash(hash_fn hash, const char *key){
+	return mix64(hash((unsigned char *)key));
+}
+
+//ring
+int ring_init(hash_ring_t *r, int vnodes, hash_fn hash){
+	memset(r, 0, sizeof(*r));
+	r->vnodes = (vnodes < 1) ? 1 : vnodes;
+	r->hash = hash;
+	r->index_shift = 64;
+	return 0;
+}
+
+void ring_free(hash_ring_t *r){
+	free(r->points);
+	free(r->index);
+	memset(r, 0, sizeof(*r));
+}
+
+static int cmp_point(const void *a, const void *b){
+	const ring_point_t *x = a, *y = b;
+
+	if(x->hash != y->hash){
+		return (x->hash > y->hash) ? 1 : -1;
+	}
+	return x->worker - y->worker;
+}
+
+// About two buckets per point, so a lookup scans one or two points
+static int ring_reindex(hash_ring_t *r){
+	size_t buckets = 1, b, i = 0;
+	int bits = 0;
+	unsigned int *index;
+
+	while(buckets < r->npoints * 2){
+		buckets <<= 1;
+		bits++;
+	}
+	index = malloc(buckets * sizeof(*index));
+	if(index == NULL){
+		return -1;
+	}
+	r->index_shift = 64 - bits;
+	for(b=0; b<buckets; b++){
+		for(; i<r->npoints && (bits == 0 ? 0 : r->points[i].hash >> r->index_shift) < b; i++);
+		index[b] = (unsigned int)i;
+	}
+	free(r->index);
+	r->index = index;
+	return 0;
+}
+
+// Add the points of a worker. Returns -1 if out of memory.
+int ring_add(hash_ring_t *r, int worker){
+	char name[32];
+	int v;
+
+	if(r->npoints + r->vnodes > r->cap){
+		size_t cap = (r->cap ? r->cap * 2 : 1024);
+		ring_point_t *p;
+
+		while(cap < r->npoints + r->vnodes){
+			cap *= 2;
+		}
+		p = realloc(r->points, cap * sizeof(*p));
+		if(p == NULL){
+			return -1;
+		}
+		r->points = p;
+		r->cap = cap;
+	}
+	for(v=0; v<r->vnodes; v++){
+		sprintf(name, "worker%d#%d", worker, v);
+		r->points[r->npoints].hash = key_hash(r->hash, name);
+		r->points[r->npoints].worker = worker;
+		r->npoints++;
+	}
+	qsort(r->points, r->npoints, sizeof(*r->points), cmp_point);
+	return ring_reindex(r);
+}
+
+// Remove the points of a worker. Its keys move to the next point on.
+int ring_remove(hash_ring_t *r, int worker){
+	size_t i, j;
+
+	for(i=0, j=0; i<r->npoints; i++){
+		if(r->points[i].worker != worker){
+			r->points[j++] = r->points[i];
+		}
+	}
+	r->npoints = j;
+	return ring_reindex(r);
+}
+
+// Worker owning hash h, or -1 if the ring is empty
+int ring_lookup_hash(const hash_ring_t *r, unsigned long long h){
+	size_t i;
+
+	if(r->npoints == 0){
+		return -1;
+	}
+	i = (r->index_shift == 64) ? 0 : r->index[h >> r->index_shift];
+	for(; i<r->npoints && r->points[i].hash < h; i++);
+	return r->points[(i == r->npoints) ? 0 : i].worker;
+}
+
+int ring_lookup(const hash_ring_t *r, const char *key){
+	return ring_lookup_hash(r, key_hash(r->hash, key));
+}
+
+// Worker of each of n keys. Hashes a block of keys first and prefetches
+// their buckets, so the index and point misses overlap.
+void ring_assign_batch(const hash_ring_t *r, char **keys, size_t n, int *out){
+	unsigned long long h[BATCH];
+	size_t i, j, m;
+
+	for(i=0; i<n; i+=BATCH){
+		m = (n - i < BATCH) ? n - i : BATCH;
+		for(j=0; j<m; j++){
+			h[j] = key_hash(r->hash, keys[i + j]);
+			if(r->index_shift < 64){
+				PREFETCH(&r->index[h[j] >> r->index_shift]);
+			}
+		}
+		for(j=0; j<m; j++){
+			out[i + j] = ring_lookup_hash(r, h[j]);
+		}
+	}
+}
+
+//jump consistent hash
+int jump_hash(unsigned long long key, int nworkers){
+	long long b = -1, j = 0;
+
+	while(j < nworkers){
+		b = j;
+		key = key * 2862933555777941757ULL + 1;
+		j = (long long)((b + 1) * ((double)(1LL << 31) / (double)((key >> 33) + 1)));
+	}
+	return (int)b;
+}
+
+void jump_assign_batch(hash_fn hash, char **keys, size_t n, int nworkers, int *out){
+	size_t i;
+
+	for(i=0; i<n; i++){
+		out[i] = jump_hash(key_hash(hash, keys[i]), nworkers);
+	}
+}
+
+void modulo_assign_batch(hash_fn hash, char **keys, size_t n, int nworkers, int *out){
+	size_t i;
+
+	for(i=0; i<n; i++){
+		out[i] = (int)(key_hash(hash, keys[i]) % (unsigned long long)nworkers);
+	}
+}
+
+//benchmark
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Largest load over the mean, and standard deviation over the mean
+static void balance(const int *owner, size_t n, int nworkers, double *peak, double *cv){
+	size_t *load = calloc(nworkers, sizeof(*load)), i;
+	double mean = (double)n / nworkers, var = 0;
+	size_t max = 0;
+	int w;
+
+	for(i=0; i<n; i++){
+		load[owner[i]]++;
+	}
+	for(w=0; w<nworkers; w++){
+		var += (load[w] - mean) * (load[w] - mean);
+		if(load[w] > max){
+			max = load[w];
+		}
+	}
+	*peak = max / mean;
+	*cv = sqrt(var / nworkers) / mean;
+	free(load);
+}
+
+static double moved(const int *a, const int *b, size_t n){
+	size_t i, m = 0;
+
+	for(i=0; i<n; i++){
+		m += (a[i] != b[i]);
+	}
+	return 100.0 * m / n;
+}
+
+static void build_ring(hash_ring_t *r, int vnodes, hash_fn hash, int nworkers){
+	int w;
+
+	ring_init(r, vnodes, hash);
+	for(w=0; w<nworkers; w++){
+		ring_add(r, w);
+	}
+}
+
+int main(int argc, char **argv){
+	size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+	int nworkers = (argc > 2) ? atoi(argv[2]) : 16;
+	static const int vnode_counts[] = {1, 10, 100, 1000};
+	char *buf = malloc(n * 24);
+	char **keys = malloc(n * sizeof(*keys));
+	int *before = malloc(n * sizeof(int)), *after = malloc(n * sizeof(int));
+	hash_ring_t ring;
+	double t, peak, cv;
+	size_t i;
+	int v;
+
+	if(buf == NULL || keys == NULL || before == NULL || after == NULL || nworkers < 2){
+		return 1;
+	}
+	for(i=0; i<n; i++){
+		keys[i] = buf + i * 24;
+		sprintf(keys[i], "user:%lu", (unsigned long)i * 7919);
+	}
+
+	printf("%lu keys, %d workers\n", (unsigned long)n, nworkers);
+	printf("%-14s %10s %10s %10s %10s %10s\n", "", "Mkeys/s", "max/mean", "stddev", "add 1", "remove 1");
+	printf("%-14s %10s %10s %10s %9.2f%% %9.2f%%\n", "(ideal)", "", "1.00", "0", 100.0 / (nworkers + 1), 100.0 / nworkers);
+
+	//ring: remove a worker from the middle
+	for(v=0; v<4; v++){
+		build_ring(&ring, vnode_counts[v], djb2_hash, nworkers);
+		t = now();
+		ring_assign_batch(&ring, keys, n, before);
+		t = now() - t;
+		balance(before, n, nworkers, &peak, &cv);
+		printf("ring x%-8d %10.2f %10.2f %10.3f", vnode_counts[v], n / t / 1e6, peak, cv);
+		ring_add(&ring, nworkers);
+		ring_assign_batch(&ring, keys, n, after);
+		printf(" %9.2f%%", moved(before, after, n));
+		ring_remove(&ring, nworkers);
+		ring_remove(&ring, nworkers / 2);
+		ring_assign_batch(&ring, keys, n, after);
+		printf(" %9.2f%%\n", moved(before, after, n));
+		ring_free(&ring);
+	}
+
+	//jump: only the last worker can go
+	t = now();
+	jump_assign_batch(djb2_hash, keys, n, nworkers, before);
+	t = now() - t;
+	balance(before, n, nworkers, &peak, &cv);
+	printf("%-14s %10.2f %10.2f %10.3f", "jump", n / t / 1e6, peak, cv);
+	jump_assign_batch(djb2_hash, keys, n, nworkers + 1, after);
+	printf(" %9.2f%%", moved(before, after, n));
+	jump_assign_batch(djb2_hash, keys, n, nworkers - 1, after);
+	printf(" %9.2f%%\n", moved(before, after, n));
+
+	t = now();
+	modulo_assign_batch(djb2_hash, keys, n, nworkers, before);
+	t = now() - t;
+	balance(before, n, nworkers, &peak, &cv);
+	printf("%-14s %10.2f %10.2f %10.3f", "hash % N", n / t / 1e6, peak, cv);
+	modulo_assign_batch(djb2_hash, keys, n, nworkers + 1, after);
+	printf(" %9.2f%%", moved(before, after, n));
+	modulo_assign_batch(djb2_hash, keys, n, nworkers - 1, after);
+	printf(" %9.2f%%\n", moved(before, after, n));
+
+	//sdbm gives the same picture
+	build_ring(&ring, 100, sdbm_hash, nworkers);
+	ring_assign_batch(&ring, keys, n, before);
+	balance(before, n, nworkers, &peak, &cv);
+	printf("ring x100 with sdbm: max/mean %.2f, stddev %.3f\n", peak, cv);
+	ring_free(&ring);
+
+	free(buf);
+	free(keys);
+	free(before);
+	free(after);
+	return 0;
+}
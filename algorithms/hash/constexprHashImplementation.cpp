@@ -0,0 +1,138 @@
+//////////////////////////////////////////////////////////////////////////////////
+// constexprHashImplementation
+// Compile-time djb2 and sdbm, giving the same values as hash() in
+// djb2HashImplementation.c and sdbm() in sdbmHashImplementation.c.
+// Hashes of string literals are folded by the compiler, so they can be
+// used as case labels and in static tables with no startup cost.
+// To run: g++ -std=c++11 constexprHashImplementation.cpp
+//////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+
+// C++11 constexpr functions are a single return statement, so the loops are
+// written as tail recursion. h*33 and h*65599 are the same as the shift
+// forms of the runtime versions.
+constexpr unsigned long djb2(const char *str, unsigned long hash = 5381)
+{
+	return *str ? djb2(str + 1, hash * 33 + (unsigned char)*str) : hash;
+}
+
+constexpr unsigned long sdbm(const char *str, unsigned long hash = 0)
+{
+	return *str ? sdbm(str + 1, (unsigned char)*str + hash * 65599) : hash;
+}
+
+// Length-aware forms, for literals that contain a NUL or for slices. They
+// have their own names, as djb2_len in stringInternImplementation.c, so
+// djb2(buf, n) cannot silently take n as the seed.
+constexpr unsigned long djb2_len(const char *str, size_t len, unsigned long hash = 5381)
+{
+	return len ? djb2_len(str + 1, len - 1, hash * 33 + (unsigned char)*str) : hash;
+}
+
+constexpr unsigned long sdbm_len(const char *str, size_t len, unsigned long hash = 0)
+{
+	return len ? sdbm_len(str + 1, len - 1, (unsigned char)*str + hash * 65599) : hash;
+}
+
+// "name"_djb2 and "name"_sdbm literals
+constexpr unsigned long operator"" _djb2(const char *str, size_t len)
+{
+	return djb2_len(str, len);
+}
+
+constexpr unsigned long operator"" _sdbm(const char *str, size_t len)
+{
+	return sdbm_len(str, len);
+}
+
+// Forces evaluation at compile time, even where a plain call to djb2()
+// would be allowed to run at runtime
+template <unsigned long H>
+struct HashConstant
+{
+	static constexpr unsigned long value = H;
+};
+
+// The runtime versions, to check that both give the same values
+unsigned long hash(const unsigned char *str)
+{
+	unsigned long hash = 5381;
+	int c;
+
+	while((c = *str++)){
+		hash = ((hash << 5) + hash) + c;
+	}
+	return hash;
+}
+
+unsigned long sdbmRuntime(const unsigned char *str)
+{
+	unsigned long hash = 0;
+	int c;
+
+	while((c = *str++)){
+		hash = c + (hash << 6) + (hash << 16) - hash;
+	}
+	return hash;
+}
+
+static_assert(djb2("") == 5381, "djb2 of empty string is the seed");
+static_assert(djb2("a") == 5381 * 33 + 'a', "djb2 of one byte");
+static_assert(sdbm("ab") == 'a' * 65599UL + 'b', "sdbm of two bytes");
+static_assert("start"_djb2 == djb2("start"), "literal matches function");
+static_assert(djb2_len("stop", 4) == djb2("stop"), "length form matches");
+static_assert(sdbm_len("a\0b", 3) == ('a' * 65599UL + 0) * 65599UL + 'b', "length form hashes a NUL");
+static_assert(HashConstant<djb2("stop")>::value == djb2("stop"), "template constant");
+
+// A static lookup table built at compile time: command name, its hash, id
+struct Command
+{
+	const char *name;
+	unsigned long hash;
+	int id;
+};
+
+constexpr Command g_Commands[] =
+{
+	{ "start",  djb2("start"),  1 },
+	{ "stop",   djb2("stop"),   2 },
+	{ "status", djb2("status"), 3 },
+	{ "reload", djb2("reload"), 4 },
+};
+
+// Dispatch on a runtime string by switching on its hash. The case labels
+// are compile-time constants; the strcmp guards against a hash collision.
+int Dispatch(const char *cmd)
+{
+	switch(djb2(cmd)){
+		case "start"_djb2:
+			return strcmp(cmd, "start") == 0 ? 1 : 0;
+		case "stop"_djb2:
+			return strcmp(cmd, "stop") == 0 ? 2 : 0;
+		case "status"_djb2:
+			return strcmp(cmd, "status") == 0 ? 3 : 0;
+		case "reload"_djb2:
+			return strcmp(cmd, "reload") == 0 ? 4 : 0;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *cmd = (argc > 1) ? argv[1] : "status";
+	int mismatches = 0;
+
+	for(size_t i = 0; i < sizeof(g_Commands) / sizeof(g_Commands[0]); i++){
+		const unsigned char *name = (const unsigned char *)g_Commands[i].name;
+		if(g_Commands[i].hash != hash(name) || sdbm(g_Commands[i].name) != sdbmRuntime(name)){
+			mismatches++;
+		}
+	}
+	printf("compile-time vs runtime mismatches: %d\n", mismatches);
+	printf("command \"%s\" dispatches to %d\n", cmd, Dispatch(cmd));
+
+	return 0;
+}
@@ -0,0 +1,365 @@
+// contentDefinedChunkingImplementation
+// Content-defined chunking and parallel chunk fingerprinting for dedup.
+// A rolling djb2 hash over the last 48 bytes picks chunk boundaries from
+// the content itself, so inserting bytes only moves the boundaries next
+// to the edit; fixed-size chunking shifts every boundary after it.
+//  - Boundary candidates are found in parallel: each thread rolls the
+//    hash over its own segment, starting 48 bytes early so the window is
+//    full. The hash of a window only depends on those 48 bytes, so this
+//    finds exactly the positions a single pass would.
+//  - One cheap sequential pass over the candidates applies the minimum
+//    and maximum chunk sizes.
+//  - Chunks are fingerprinted in parallel by a pool of threads taking
+//    chunks off a shared counter. The fingerprint is word-at-a-time djb2
+//    and sdbm side by side, 128 bits. It is fine for finding duplicate
+//    content, but it is not collision resistant against crafted input.
+// The input is mmap'd and never copied.
+// Usage: contentDefinedChunkingImplementation [file] [threads]
+// To run: gcc -O2 -pthread contentDefinedChunkingImplementation.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define WINDOW 48
+#define MIN_CHUNK 2048
+#define AVG_BITS 13		// about 8 KB between boundaries
+#define MAX_CHUNK 65536
+#define MAX_THREADS 64
+
+typedef struct chunk{
+	size_t offset, len;
+	unsigned long long fp[2];	// djb2, sdbm
+} chunk_t;
+
+// Word-at-a-time djb2/sdbm from djb2HashImplementation.c and
+// sdbmHashImplementation.c
+#define DJB2_P1 33UL
+#define DJB2_P2 (DJB2_P1 * DJB2_P1)
+#define DJB2_P4 (DJB2_P2 * DJB2_P2)
+#define SDBM_P1 65599UL
+#define SDBM_P2 (SDBM_P1 * SDBM_P1)
+#define SDBM_P4 (SDBM_P2 * SDBM_P2)
+
+unsigned long djb2_update_hash(unsigned long hash, const unsigned char *p, size_t len){
+	while(len >= 8){
+		hash = hash * (DJB2_P4 * DJB2_P4)
+			+ (p[0] * (DJB2_P4 * DJB2_P2 * DJB2_P1) + p[1] * (DJB2_P4 * DJB2_P2) + p[2] * (DJB2_P4 * DJB2_P1) + p[3] * DJB2_P4)
+			+ (p[4] * (DJB2_P2 * DJB2_P1) + p[5] * DJB2_P2 + p[6] * DJB2_P1 + p[7]);
+		p += 8;
+		len -= 8;
+	}
+	while(len--){
+		hash = ((hash << 5) + hash) + *p++;
+	}
+	return hash;
+}
+
+unsigned long sdbm_update_hash(unsigned long hash, const unsigned char *p, size_t len){
+	while(len >= 8){
+		hash = hash * (SDBM_P4 * SDBM_P4)
+			+ (p[0] * (SDBM_P4 * SDBM_P2 * SDBM_P1) + p[1] * (SDBM_P4 * SDBM_P2) + p[2] * (SDBM_P4 * SDBM_P1) + p[3] * SDBM_P4)
+			+ (p[4] * (SDBM_P2 * SDBM_P1) + p[5] * SDBM_P2 + p[6] * SDBM_P1 + p[7]);
+		p += 8;
+		len -= 8;
+	}
+	while(len--){
+		hash = *p++ + (hash << 6) + (hash << 16) - hash;
+	}
+	return hash;
+}
+
+//boundary candidates
+typedef struct scan_job{
+	const unsigned char *data;
+	size_t start, end;	// positions this thread decides on
+	size_t *cand;		// positions p where a boundary may follow byte p-1
+	size_t ncand, cap;
+} scan_job_t;
+
+// Rolling djb2 over the last WINDOW bytes. The window hash is mixed and a
+// boundary is allowed after byte p when its top AVG_BITS bits are zero.
+static void *scan_segment(void *arg){
+	scan_job_t *j = arg;
+	const unsigned char *d = j->data;
+	unsigned long r = 0, out_pow = 1;
+	size_t p, from;
+	int i;
+
+	for(i=1; i<WINDOW; i++){
+		out_pow *= 33;
+	}
+	from = (j->start >= WINDOW) ? j->start - WINDOW : 0;
+	for(p=from; p<j->end; p++){
+		if(p >= from + WINDOW){
+			r -= d[p - WINDOW] * out_pow;
+		}
+		r = ((r << 5) + r) + d[p];
+		if(p + 1 > j->start && p + 1 - from >= WINDOW
+				&& ((unsigned long long)r * 0x9E3779B97F4A7C15ULL) >> (64 - AVG_BITS) == 0){
+			if(j->ncand == j->cap){
+				j->cap = j->cap ? j->cap * 2 : 1024;
+				j->cand = realloc(j->cand, j->cap * sizeof(*j->cand));
+			}
+			j->cand[j->ncand++] = p + 1;
+		}
+	}
+	return NULL;
+}
+
+// Boundaries of the whole buffer: candidates found by nthreads threads,
+// then the minimum and maximum chunk sizes applied in order
+chunk_t *cdc_chunk(const unsigned char *data, size_t n, int nthreads, size_t *nchunks){
+	scan_job_t job[MAX_THREADS];
+	pthread_t th[MAX_THREADS];
+	chunk_t *chunks = NULL;
+	size_t count = 0, cap = 0, last = 0, next, c;
+	int t;
+
+	for(t=0; t<nthreads; t++){
+		job[t].data = data;
+		job[t].start = n / nthreads * t;
+		job[t].end = (t == nthreads - 1) ? n : n / nthreads * (t + 1);
+		job[t].cand = NULL;
+		job[t].ncand = job[t].cap = 0;
+		pthread_create(&th[t], NULL, scan_segment, &job[t]);
+	}
+	for(t=0; t<nthreads; t++){
+		pthread_join(th[t], NULL);
+	}
+
+	t = 0;
+	c = 0;
+	while(last < n){
+		//next candidate at least MIN_CHUNK past the last boundary
+		next = n;
+		for(; t<nthreads; t++, c=0){
+			for(; c<job[t].ncand && job[t].cand[c] < last + MIN_CHUNK; c++);
+			if(c < job[t].ncand){
+				next = job[t].cand[c];
+				break;
+			}
+		}
+		if(next - last > MAX_CHUNK){
+			next = last + MAX_CHUNK;
+		}
+		if(count == cap){
+			cap = cap ? cap * 2 : 1024;
+			chunks = realloc(chunks, cap * sizeof(*chunks));
+		}
+		chunks[count].offset = last;
+		chunks[count].len = next - last;
+		count++;
+		last = next;
+	}
+
+	for(t=0; t<nthreads; t++){
+		free(job[t].cand);
+	}
+	*nchunks = count;
+	return chunks;
+}
+
+// Fixed-size chunks, for comparison
+chunk_t *fixed_chunk(size_t n, size_t size, size_t *nchunks){
+	size_t count = (n + size - 1) / size, i;
+	chunk_t *chunks = malloc(count * sizeof(*chunks));
+
+	for(i=0; i<count; i++){
+		chunks[i].offset = i * size;
+		chunks[i].len = (i == count - 1) ? n - i * size : size;
+	}
+	*nchunks = count;
+	return chunks;
+}
+
+//fingerprinting pool
+typedef struct hash_pool{
+	const unsigned char *data;
+	chunk_t *chunks;
+	size_t nchunks;
+	atomic_size_t next;
+} hash_pool_t;
+
+#define HASH_GRAB 16	// chunks taken from the counter at a time
+
+static void *hash_worker(void *arg){
+	hash_pool_t *pool = arg;
+	size_t i, end;
+	chunk_t *c;
+
+	for(;;){
+		i = atomic_fetch_add(&pool->next, HASH_GRAB);
+		if(i >= pool->nchunks){
+			return NULL;
+		}
+		end = (i + HASH_GRAB < pool->nchunks) ? i + HASH_GRAB : pool->nchunks;
+		for(; i<end; i++){
+			c = &pool->chunks[i];
+			c->fp[0] = djb2_update_hash(5381, pool->data + c->offset, c->len);
+			c->fp[1] = sdbm_update_hash(0, pool->data + c->offset, c->len);
+		}
+	}
+}
+
+void fingerprint_chunks(const unsigned char *data, chunk_t *chunks, size_t nchunks, int nthreads){
+	pthread_t th[MAX_THREADS];
+	hash_pool_t pool;
+	int t;
+
+	pool.data = data;
+	pool.chunks = chunks;
+	pool.nchunks = nchunks;
+	atomic_init(&pool.next, 0);
+	for(t=0; t<nthreads; t++){
+		pthread_create(&th[t], NULL, hash_worker, &pool);
+	}
+	for(t=0; t<nthreads; t++){
+		pthread_join(th[t], NULL);
+	}
+}
+
+// Bytes in chunks whose fingerprint was already seen
+size_t duplicate_bytes(const chunk_t *chunks, size_t nchunks){
+	size_t cap = 16, i, pos, dup = 0;
+	const chunk_t **seen;
+
+	while(cap < nchunks * 2){
+		cap <<= 1;
+	}
+	seen = calloc(cap, sizeof(*seen));
+	if(seen == NULL){
+		return 0;
+	}
+	for(i=0; i<nchunks; i++){
+		for(pos=chunks[i].fp[0] & (cap - 1); seen[pos]; pos=(pos + 1) & (cap - 1)){
+			if(seen[pos]->fp[0] == chunks[i].fp[0] && seen[pos]->fp[1] == chunks[i].fp[1]
+					&& seen[pos]->len == chunks[i].len){
+				break;
+			}
+		}
+		if(seen[pos]){
+			dup += chunks[i].len;
+		}else{
+			seen[pos] = &chunks[i];
+		}
+	}
+	free(seen);
+	return dup;
+}
+
+// Backup-like test data: random blocks where later "versions" repeat
+// earlier content with small insertions, which shifts everything after
+static unsigned char *synthetic_backup(size_t n){
+	unsigned char *d = malloc(n);
+	unsigned long long x = 12345;
+	size_t p = 0, src, len, i;
+
+	if(d == NULL){
+		return NULL;
+	}
+	while(p < n){
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		len = 4096 + (size_t)(x % (1u << 20));
+		if(len > n - p){
+			len = n - p;
+		}
+		if(p > (4u << 20) && (x >> 40) % 4 != 0){
+			//copy an earlier stretch, then insert a few new bytes
+			if(len > p / 2){
+				len = p / 2;
+			}
+			src = (size_t)((x >> 20) % (p - len));
+			memcpy(d + p, d + src, len);
+		}else{
+			for(i=0; i<len; i++){
+				x ^= x << 13;
+				x ^= x >> 7;
+				x ^= x << 17;
+				d[p + i] = (unsigned char)x;
+			}
+		}
+		p += len;
+		for(i=0; i<(x & 15) && p<n; i++){
+			d[p++] = (unsigned char)(x >> (i * 3));
+		}
+	}
+	return d;
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv){
+	int nthreads = (argc > 2) ? atoi(argv[2]) : 4;
+	const unsigned char *data;
+	unsigned char *owned = NULL;
+	size_t n, nc, nf, dc, df;
+	chunk_t *cdc, *fixed;
+	struct stat st;
+	double t, tc, th;
+	int fd = -1;
+
+	if(nthreads < 1 || nthreads > MAX_THREADS){
+		return 1;
+	}
+	if(argc > 1){
+		fd = open(argv[1], O_RDONLY);
+		if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0){
+			printf("Could not read %s\n", argv[1]);
+			return 1;
+		}
+		n = (size_t)st.st_size;
+		data = mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data == MAP_FAILED){
+			printf("Could not map %s\n", argv[1]);
+			return 1;
+		}
+	}else{
+		n = 512u << 20;
+		owned = synthetic_backup(n);
+		if(owned == NULL){
+			return 1;
+		}
+		data = owned;
+	}
+
+	t = now();
+	cdc = cdc_chunk(data, n, nthreads, &nc);
+	tc = now() - t;
+	t = now();
+	fingerprint_chunks(data, cdc, nc, nthreads);
+	th = now() - t;
+	dc = duplicate_bytes(cdc, nc);
+
+	fixed = fixed_chunk(n, 1u << AVG_BITS, &nf);
+	fingerprint_chunks(data, fixed, nf, nthreads);
+	df = duplicate_bytes(fixed, nf);
+
+	printf("%.1f MB, %d threads\n", n / 1e6, nthreads);
+	printf("content-defined: %lu chunks (avg %lu bytes), chunking %.2f GB/s, hashing %.2f GB/s\n",
+		(unsigned long)nc, (unsigned long)(n / nc), n / tc / 1e9, n / th / 1e9);
+	printf("content-defined: %.1f%% duplicate bytes\n", 100.0 * dc / n);
+	printf("fixed %u bytes:  %.1f%% duplicate bytes\n", 1u << AVG_BITS, 100.0 * df / n);
+
+	free(cdc);
+	free(fixed);
+	if(fd >= 0){
+		munmap((void *)data, n);
+		close(fd);
+	}
+	free(owned);
+	return 0;
+}
@@ -0,0 +1,260 @@
+// countMinSketchImplementation
+// Count-min sketch for counting items in a stream that does not fit in
+// memory. depth rows of width counters; an item adds to one counter per
+// row and its estimate is the smallest of those counters, which can only
+// overcount. Row positions come from Kirsch-Mitzenmacher double hashing,
+// g_i = h1 + i*h2, with djb2 and sdbm as the two base hashes.
+// Sketches of the same shape merge by adding counters, so shards of a
+// stream can be counted in parallel and combined.
+// main() counts a Zipf-like stream and compares estimates to exact counts.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define BATCH 16
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+
+typedef struct count_min{
+	unsigned int *counts;	// depth rows of width counters
+	size_t width;		// power of two
+	int depth;
+} count_min_t;
+
+// djb2HashImplementation.c and sdbmHashImplementation.c
+unsigned long djb2_hash(unsigned char *str){
+	unsigned long hash = 5381;
+	int c;
+
+	while((c = *str++)){
+		hash = ((hash << 5) + hash) + c;
+	}
+	return hash;
+}
+
+unsigned long sdbm_hash(unsigned char *str){
+	unsigned long hash = 0;
+	int c;
+
+	while((c = *str++)){
+		hash = c + (hash << 6) + (hash << 16) - hash;
+	}
+	return hash;
+}
+
+static unsigned long long mix64(unsigned long long x){
+	x ^= x >> 33;
+	x *= 0xFF51AFD7ED558CCDULL;
+	x ^= x >> 33;
+	x *= 0xC4CEB9FE1A85EC53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+typedef struct key_hash{
+	unsigned long long h1, h2;
+} key_hash_t;
+
+static key_hash_t cm_hash(const char *key){
+	key_hash_t h;
+	h.h1 = mix64(djb2_hash((unsigned char *)key));
+	h.h2 = mix64(sdbm_hash((unsigned char *)key)) | 1;
+	return h;
+}
+
+// Width e/epsilon and depth ln(1/delta) bound the overcount by
+// epsilon * (stream length) with probability 1 - delta
+int cm_init(count_min_t *cm, double epsilon, double delta){
+	size_t want = (size_t)ceil(2.718281828 / epsilon);
+
+	cm->width = 1;
+	while(cm->width < want){
+		cm->width <<= 1;
+	}
+	cm->depth = (int)ceil(log(1.0 / delta));
+	if(cm->depth < 1){
+		cm->depth = 1;
+	}
+	cm->counts = calloc(cm->width * cm->depth, sizeof(*cm->counts));
+	return (cm->counts == NULL) ? -1 : 0;
+}
+
+void cm_free(count_min_t *cm){
+	free(cm->counts);
+	cm->counts = NULL;
+}
+
+static unsigned int *cm_cell(const count_min_t *cm, key_hash_t h, int row){
+	return cm->counts + row * cm->width + ((h.h1 + row * h.h2) & (cm->width - 1));
+}
+
+static void cm_prefetch(const count_min_t *cm, key_hash_t h){
+	int r;
+	for(r=0; r<cm->depth; r++){
+		PREFETCH(cm_cell(cm, h, r));
+	}
+}
+
+static void cm_add_hash(count_min_t *cm, key_hash_t h, unsigned int count){
+	int r;
+	for(r=0; r<cm->depth; r++){
+		*cm_cell(cm, h, r) += count;
+	}
+}
+
+static unsigned int cm_estimate_hash(const count_min_t *cm, key_hash_t h){
+	unsigned int est = *cm_cell(cm, h, 0), c;
+	int r;
+
+	for(r=1; r<cm->depth; r++){
+		c = *cm_cell(cm, h, r);
+		if(c < est){
+			est = c;
+		}
+	}
+	return est;
+}
+
+void cm_add(count_min_t *cm, const char *key, unsigned int count){
+	cm_add_hash(cm, cm_hash(key), count);
+}
+
+unsigned int cm_estimate(const count_min_t *cm, const char *key){
+	return cm_estimate_hash(cm, cm_hash(key));
+}
+
+// Count each of n keys once
+void cm_add_batch(count_min_t *cm, char **keys, size_t n){
+	key_hash_t h[BATCH];
+	size_t i, j, m;
+
+	for(i=0; i<n; i+=BATCH){
+		m = (n - i < BATCH) ? n - i : BATCH;
+		for(j=0; j<m; j++){
+			h[j] = cm_hash(keys[i + j]);
+			cm_prefetch(cm, h[j]);
+		}
+		for(j=0; j<m; j++){
+			cm_add_hash(cm, h[j], 1);
+		}
+	}
+}
+
+void cm_estimate_batch(const count_min_t *cm, char **keys, size_t n, unsigned int *out){
+	key_hash_t h[BATCH];
+	size_t i, j, m;
+
+	for(i=0; i<n; i+=BATCH){
+		m = (n - i < BATCH) ? n - i : BATCH;
+		for(j=0; j<m; j++){
+			h[j] = cm_hash(keys[i + j]);
+			cm_prefetch(cm, h[j]);
+		}
+		for(j=0; j<m; j++){
+			out[i + j] = cm_estimate_hash(cm, h[j]);
+		}
+	}
+}
+
+// dst += src. Both must have the same width and depth.
+int cm_merge(count_min_t *dst, const count_min_t *src){
+	size_t i;
+
+	if(dst->width != src->width || dst->depth != src->depth){
+		return -1;
+	}
+	for(i=0; i<dst->width * dst->depth; i++){
+		dst->counts[i] += src->counts[i];
+	}
+	return 0;
+}
+
+//demo: Zipf-like stream over `items` distinct keys, split in two shards
+int main(int argc, char **argv){
+	size_t items = (argc > 1) ? strtoul(argv[1], NULL, 10) : 100000;
+	size_t len = (argc > 2) ? strtoul(argv[2], NULL, 10) : 5000000;
+	char *names = malloc(items * 16);
+	char **name = malloc(items * sizeof(*name));
+	char **stream = malloc(len * sizeof(*stream));
+	unsigned int *exact = calloc(items, sizeof(*exact));
+	unsigned int *est = malloc(items * sizeof(*est));
+	double *cdf = malloc(items * sizeof(*cdf));
+	count_min_t cm, shard;
+	size_t i, lo, hi, mid, top = 0;
+	double total = 0, u, err = 0, maxerr = 0;
+	clock_t start;
+	double sec;
+
+	if(names == NULL || name == NULL || stream == NULL || exact == NULL || est == NULL || cdf == NULL){
+		return 1;
+	}
+	for(i=0; i<items; i++){
+		name[i] = names + i * 16;
+		sprintf(name[i], "item%lu", (unsigned long)i);
+		total += 1.0 / (i + 1);
+		cdf[i] = total;
+	}
+	srand(7);
+	for(i=0; i<len; i++){
+		u = (double)rand() / RAND_MAX * total;
+		for(lo=0, hi=items-1; lo<hi; ){
+			mid = (lo + hi) / 2;
+			if(cdf[mid] < u){
+				lo = mid + 1;
+			}else{
+				hi = mid;
+			}
+		}
+		stream[i] = name[lo];
+		exact[lo]++;
+	}
+
+	cm_init(&cm, 0.0001, 0.01);
+	cm_init(&shard, 0.0001, 0.01);
+	start = clock();
+	cm_add_batch(&cm, stream, len / 2);
+	cm_add_batch(&shard, stream + len / 2, len - len / 2);
+	sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+	cm_merge(&cm, &shard);
+	cm_estimate_batch(&cm, name, items, est);
+
+	for(i=0; i<items; i++){
+		u = (double)est[i] - exact[i];
+		err += u;
+		if(u > maxerr){
+			maxerr = u;
+		}
+		if(est[i] < exact[i]){
+			printf("undercount on %s\n", name[i]);
+		}
+	}
+	printf("%lu updates, %lu distinct, width %lu depth %d (%lu KB)\n",
+		(unsigned long)len, (unsigned long)items, (unsigned long)cm.width, cm.depth,
+		(unsigned long)(cm.width * cm.depth * sizeof(unsigned int) / 1024));
+	printf("%.2f M updates/s, mean overcount %.2f, max overcount %.0f (bound %.0f)\n",
+		len / sec / 1e6, err / items, maxerr, 0.0001 * len);
+	printf("heavy hitters:\n");
+	for(i=0; i<items && top<10; i++){
+		if(est[i] >= len / 100){
+			printf("  %-10s estimate %8u exact %8u\n", name[i], est[i], exact[i]);
+			top++;
+		}
+	}
+
+	cm_free(&cm);
+	cm_free(&shard);
+	free(names);
+	free(name);
+	free(stream);
+	free(exact);
+	free(est);
+	free(cdf);
+	return 0;
+}
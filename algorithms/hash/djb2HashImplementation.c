@@ -1,11 +1,60 @@
-unsigned long;
+#include <stddef.h>
 
-hash(unsigned char *str){
+unsigned long hash(unsigned char *str){
 	unsigned long hash = 5381;
 	int c;
-	
-	while(c = *str++){
+
+	while((c = *str++)){
 		hash = ((hash << 5) + hash) + c;
 	}
 	return hash;
-}
\ No newline at end of file
+}
+
+// Powers of 33, so 8 bytes can be folded into the hash in one step:
+// hash*33^8 + c0*33^7 + ... + c7 is the same as 8 rounds of the loop above,
+// but the byte terms no longer depend on each other.
+#define DJB2_P1 33UL
+#define DJB2_P2 (DJB2_P1 * DJB2_P1)
+#define DJB2_P3 (DJB2_P2 * DJB2_P1)
+#define DJB2_P4 (DJB2_P2 * DJB2_P2)
+#define DJB2_P5 (DJB2_P4 * DJB2_P1)
+#define DJB2_P6 (DJB2_P4 * DJB2_P2)
+#define DJB2_P7 (DJB2_P4 * DJB2_P3)
+#define DJB2_P8 (DJB2_P4 * DJB2_P4)
+
+typedef struct djb2_state{
+	unsigned long hash;
+} djb2_state_t;
+
+// Continue a djb2 hash over len bytes, 8 bytes per step
+unsigned long djb2_update_hash(unsigned long hash, const unsigned char *p, size_t len){
+	while(len >= 8){
+		hash = hash * DJB2_P8
+			+ (p[0] * DJB2_P7 + p[1] * DJB2_P6 + p[2] * DJB2_P5 + p[3] * DJB2_P4)
+			+ (p[4] * DJB2_P3 + p[5] * DJB2_P2 + p[6] * DJB2_P1 + p[7]);
+		p += 8;
+		len -= 8;
+	}
+	while(len--){
+		hash = ((hash << 5) + hash) + *p++;
+	}
+	return hash;
+}
+
+// Length-aware djb2, same value as hash() for keys without a NUL byte
+unsigned long djb2_len(const unsigned char *p, size_t len){
+	return djb2_update_hash(5381, p, len);
+}
+
+//streaming interface, feed the input in chunks of any size
+void djb2_init(djb2_state_t *state){
+	state->hash = 5381;
+}
+
+void djb2_update(djb2_state_t *state, const void *data, size_t len){
+	state->hash = djb2_update_hash(state->hash, (const unsigned char *)data, len);
+}
+
+unsigned long djb2_final(const djb2_state_t *state){
+	return state->hash;
+}
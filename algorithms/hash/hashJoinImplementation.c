@@ -0,0 +1,499 @@
+// hashJoinImplementation
+// Equi-join of two relations of (int key, int payload) tuples, two ways:
+//  - Radix hash join: both relations are partitioned by the top bits of a
+//    multiplicative hash so that each partition of the build side R is
+//    about 64 KB and its hash table stays in cache. Each partition pair is
+//    then joined alone: a bucket-chained table is built over R_p and S_p
+//    probes it.
+//  - Sort-merge join: both relations are range-partitioned by the top
+//    bits of the key, then each partition pair is sorted and merged. The
+//    sort is a merge sort with insertion sort (insertionSortImplementation.c)
+//    for runs of 16. The merge skips ahead with exponential steps then a
+//    binary search (binarySearchImplementation.c), so a small R against a
+//    large S does not walk every tuple of S.
+// Partitioning is parallel: each thread counts its slice per partition,
+// then scatters it into place. The joins hand out partition pairs
+// largest first, so one hot partition does not start last and hold up
+// the others.
+// Neither join materializes its output. Both return the number of
+// matches and a checksum of the matched payloads, which must agree.
+// main() sweeps |S|/|R| and the Zipf skew of S's keys.
+// To run: gcc -O2 -pthread hashJoinImplementation.c -lm
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#define HASH_MUL 0x9E3779B97F4A7C15ULL
+#define PART_TUPLES 8192	// target R tuples per partition, 64 KB
+#define MAX_PART_BITS 14
+#define MAX_THREADS 64
+#define INSERTION_RUN 16
+
+typedef struct tuple{
+	int key;
+	int payload;
+} tuple_t;
+
+typedef struct join_result{
+	unsigned long long matches;
+	unsigned long long checksum;	// sum of r.payload * 31 + s.payload
+} join_result_t;
+
+typedef struct relation{
+	tuple_t *tuples;
+	size_t n;
+} relation_t;
+
+static unsigned int part_of(int key, int bits, int by_range){
+	if(by_range){
+		//flip the sign bit so partitions are in key order
+		return ((unsigned int)key ^ 0x80000000u) >> (32 - bits);
+	}
+	return (unsigned int)(((unsigned long long)(unsigned int)key * HASH_MUL) >> (64 - bits));
+}
+
+//parallel partitioning
+typedef struct part_job{
+	const tuple_t *in;
+	tuple_t *out;
+	size_t start, end;
+	size_t *hist;		// counts per partition, then write offsets
+	int bits, by_range;
+} part_job_t;
+
+static void *part_count(void *arg){
+	part_job_t *j = arg;
+	size_t i;
+
+	for(i=j->start; i<j->end; i++){
+		j->hist[part_of(j->in[i].key, j->bits, j->by_range)]++;
+	}
+	return NULL;
+}
+
+static void *part_scatter(void *arg){
+	part_job_t *j = arg;
+	size_t i;
+
+	for(i=j->start; i<j->end; i++){
+		j->out[j->hist[part_of(j->in[i].key, j->bits, j->by_range)]++] = j->in[i];
+	}
+	return NULL;
+}
+
+// Copy rel into out grouped by partition. Partition p ends up in
+// out[start[p] .. start[p + 1]). Returns -1 if out of memory.
+static int partition_relation(const relation_t *rel, tuple_t *out, size_t *start, int bits, int by_range, int nthreads){
+	size_t nparts = (size_t)1 << bits, p, off = 0, c;
+	size_t *hist = calloc(nparts * nthreads, sizeof(*hist));
+	part_job_t job[MAX_THREADS];
+	pthread_t th[MAX_THREADS];
+	int t;
+
+	if(hist == NULL){
+		return -1;
+	}
+	for(t=0; t<nthreads; t++){
+		job[t].in = rel->tuples;
+		job[t].out = out;
+		job[t].start = rel->n / nthreads * t;
+		job[t].end = (t == nthreads - 1) ? rel->n : rel->n / nthreads * (t + 1);
+		job[t].hist = hist + nparts * t;
+		job[t].bits = bits;
+		job[t].by_range = by_range;
+		pthread_create(&th[t], NULL, part_count, &job[t]);
+	}
+	for(t=0; t<nthreads; t++){
+		pthread_join(th[t], NULL);
+	}
+	for(p=0; p<nparts; p++){
+		start[p] = off;
+		for(t=0; t<nthreads; t++){
+			c = job[t].hist[p];
+			job[t].hist[p] = off;
+			off += c;
+		}
+	}
+	start[nparts] = off;
+	for(t=0; t<nthreads; t++){
+		pthread_create(&th[t], NULL, part_scatter, &job[t]);
+	}
+	for(t=0; t<nthreads; t++){
+		pthread_join(th[t], NULL);
+	}
+	free(hist);
+	return 0;
+}
+
+//per-partition joins
+typedef struct join_pool{
+	tuple_t *r, *s;			// partitioned copies
+	size_t *r_start, *s_start;
+	int *order;			// partitions, largest first
+	size_t nparts, max_r, max_s;
+	int bits;
+	atomic_size_t next;
+	atomic_int failed;
+	join_result_t part[MAX_THREADS];	// written once per thread at the end
+} join_pool_t;
+
+typedef struct join_worker_arg{
+	join_pool_t *pool;
+	int id;
+} join_worker_arg_t;
+
+// Bucket-chained table over R_p. heads and next hold tuple index + 1.
+static void hash_join_partition(const tuple_t *r, size_t nr, const tuple_t *s, size_t ns, int bits,
+		unsigned int *heads, unsigned int *next, join_result_t *res){
+	size_t nbuckets = 1, i;
+	unsigned int b, k;
+	int bbits = 0;
+
+	while(nbuckets < nr){
+		nbuckets <<= 1;
+		bbits++;
+	}
+	memset(heads, 0, nbuckets * sizeof(*heads));
+	//the top `bits` bits are the same for the whole partition, use the next ones
+	for(i=0; i<nr; i++){
+		b = bbits ? (unsigned int)((((unsigned long long)(unsigned int)r[i].key * HASH_MUL) << bits) >> (64 - bbits)) : 0;
+		next[i] = heads[b];
+		heads[b] = (unsigned int)i + 1;
+	}
+	for(i=0; i<ns; i++){
+		b = bbits ? (unsigned int)((((unsigned long long)(unsigned int)s[i].key * HASH_MUL) << bits) >> (64 - bbits)) : 0;
+		for(k=heads[b]; k; k=next[k - 1]){
+			if(r[k - 1].key == s[i].key){
+				res->matches++;
+				res->checksum += (unsigned long long)r[k - 1].payload * 31 + (unsigned long long)s[i].payload;
+			}
+		}
+	}
+}
+
+static void insertion_sort(tuple_t *a, size_t n){
+	size_t i, j;
+	tuple_t key;
+
+	for(i=1; i<n; i++){
+		key = a[i];
+		for(j=i; j>0 && a[j - 1].key > key.key; j--){
+			a[j] = a[j - 1];
+		}
+		a[j] = key;
+	}
+}
+
+// Bottom-up merge sort by key, runs of INSERTION_RUN sorted by insertion
+// sort first. tmp has room for n tuples.
+static void merge_sort(tuple_t *a, size_t n, tuple_t *tmp){
+	tuple_t *src = a, *dst = tmp, *swap;
+	size_t width, lo, mid, hi, i, j, k;
+
+	for(lo=0; lo<n; lo+=INSERTION_RUN){
+		insertion_sort(a + lo, (n - lo < INSERTION_RUN) ? n - lo : INSERTION_RUN);
+	}
+	for(width=INSERTION_RUN; width<n; width*=2){
+		for(lo=0; lo<n; lo+=2*width){
+			mid = (lo + width < n) ? lo + width : n;
+			hi = (lo + 2 * width < n) ? lo + 2 * width : n;
+			for(i=lo, j=mid, k=lo; i<mid && j<hi; ){
+				dst[k++] = (src[j].key < src[i].key) ? src[j++] : src[i++];
+			}
+			while(i < mid){
+				dst[k++] = src[i++];
+			}
+			while(j < hi){
+				dst[k++] = src[j++];
+			}
+		}
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if(src != a){
+		memcpy(a, src, n * sizeof(*a));
+	}
+}
+
+// First index in [lo, hi) whose key is >= key. Steps of 1, 2, 4, ... find
+// a range holding it, then binary search finishes, so skipping d tuples
+// costs O(log d).
+static size_t gallop(const tuple_t *a, size_t lo, size_t hi, int key){
+	size_t step = 1, l = lo, r, mid;
+
+	while(lo + step < hi && a[lo + step].key < key){
+		l = lo + step;
+		step *= 2;
+	}
+	r = (lo + step < hi) ? lo + step : hi;
+	//a[l] < key or l == lo; a[r] >= key or r == hi
+	while(l < r){
+		mid = l + (r - l) / 2;
+		if(a[mid].key < key){
+			l = mid + 1;
+		}else{
+			r = mid;
+		}
+	}
+	return l;
+}
+
+static void merge_join_partition(tuple_t *r, size_t nr, tuple_t *s, size_t ns, tuple_t *tmp, join_result_t *res){
+	size_t i = 0, j = 0, ie, je, k;
+	unsigned long long sum_r, sum_s;
+	int key;
+
+	merge_sort(r, nr, tmp);
+	merge_sort(s, ns, tmp);
+	while(i < nr && j < ns){
+		if(r[i].key < s[j].key){
+			i = gallop(r, i, nr, s[j].key);
+		}else if(r[i].key > s[j].key){
+			j = gallop(s, j, ns, r[i].key);
+		}else{
+			key = r[i].key;
+			sum_r = sum_s = 0;
+			for(ie=i; ie<nr && r[ie].key == key; ie++){
+				sum_r += (unsigned long long)r[ie].payload;
+			}
+			for(je=j; je<ns && s[je].key == key; je++){
+				sum_s += (unsigned long long)s[je].payload;
+			}
+			k = (ie - i) * (je - j);
+			res->matches += k;
+			res->checksum += 31 * sum_r * (je - j) + sum_s * (ie - i);
+			i = ie;
+			j = je;
+		}
+	}
+}
+
+static void *hash_join_worker(void *arg){
+	join_worker_arg_t *a = arg;
+	join_pool_t *pool = a->pool;
+	join_result_t res = {0, 0};
+	size_t nbuckets = 1, i;
+	unsigned int *heads, *next;
+	int p;
+
+	while(nbuckets < pool->max_r){
+		nbuckets <<= 1;
+	}
+	heads = malloc(nbuckets * sizeof(*heads));
+	next = malloc((pool->max_r + 1) * sizeof(*next));
+	if(heads == NULL || next == NULL){
+		atomic_store(&pool->failed, 1);
+	}else{
+		while((i = atomic_fetch_add(&pool->next, 1)) < pool->nparts){
+			p = pool->order[i];
+			hash_join_partition(pool->r + pool->r_start[p], pool->r_start[p + 1] - pool->r_start[p],
+				pool->s + pool->s_start[p], pool->s_start[p + 1] - pool->s_start[p], pool->bits,
+				heads, next, &res);
+		}
+	}
+	pool->part[a->id] = res;
+	free(heads);
+	free(next);
+	return NULL;
+}
+
+static void *merge_join_worker(void *arg){
+	join_worker_arg_t *a = arg;
+	join_pool_t *pool = a->pool;
+	size_t max = (pool->max_r > pool->max_s) ? pool->max_r : pool->max_s, i;
+	tuple_t *tmp = malloc((max + 1) * sizeof(*tmp));
+	join_result_t res = {0, 0};
+	int p;
+
+	if(tmp == NULL){
+		atomic_store(&pool->failed, 1);
+		return NULL;
+	}
+	while((i = atomic_fetch_add(&pool->next, 1)) < pool->nparts){
+		p = pool->order[i];
+		merge_join_partition(pool->r + pool->r_start[p], pool->r_start[p + 1] - pool->r_start[p],
+			pool->s + pool->s_start[p], pool->s_start[p + 1] - pool->s_start[p], tmp, &res);
+	}
+	pool->part[a->id] = res;
+	free(tmp);
+	return NULL;
+}
+
+static join_pool_t *sort_pool;
+
+static int cmp_part_size(const void *a, const void *b){
+	int x = *(const int *)a, y = *(const int *)b;
+	size_t sx = sort_pool->r_start[x + 1] - sort_pool->r_start[x] + sort_pool->s_start[x + 1] - sort_pool->s_start[x];
+	size_t sy = sort_pool->r_start[y + 1] - sort_pool->r_start[y] + sort_pool->s_start[y + 1] - sort_pool->s_start[y];
+	return (sx < sy) - (sx > sy);
+}
+
+typedef struct join_timing{
+	double partition_sec, join_sec;
+} join_timing_t;
+
+// Partition R and S, then join the partition pairs on nthreads threads.
+// by_range selects the sort-merge join, otherwise the hash join. Returns
+// -1 if out of memory.
+static int run_join(const relation_t *r, const relation_t *s, int nthreads, int by_range, join_result_t *res, join_timing_t *tm){
+	join_pool_t pool;
+	join_worker_arg_t arg[MAX_THREADS];
+	pthread_t th[MAX_THREADS];
+	struct timespec t0, t1, t2;
+	size_t p, sz;
+	int bits = 1, t, ok;
+
+	while(bits < MAX_PART_BITS && (r->n >> bits) > PART_TUPLES){
+		bits++;
+	}
+	memset(&pool, 0, sizeof(pool));
+	pool.nparts = (size_t)1 << bits;
+	pool.bits = bits;
+	pool.r = malloc(r->n * sizeof(tuple_t) + 1);
+	pool.s = malloc(s->n * sizeof(tuple_t) + 1);
+	pool.r_start = malloc((pool.nparts + 1) * sizeof(size_t));
+	pool.s_start = malloc((pool.nparts + 1) * sizeof(size_t));
+	pool.order = malloc(pool.nparts * sizeof(int));
+	ok = pool.r != NULL && pool.s != NULL && pool.r_start != NULL && pool.s_start != NULL && pool.order != NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	ok = ok && partition_relation(r, pool.r, pool.r_start, bits, by_range, nthreads) == 0
+		&& partition_relation(s, pool.s, pool.s_start, bits, by_range, nthreads) == 0;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	if(ok){
+		for(p=0; p<pool.nparts; p++){
+			pool.order[p] = (int)p;
+			sz = pool.r_start[p + 1] - pool.r_start[p];
+			pool.max_r = (sz > pool.max_r) ? sz : pool.max_r;
+			sz = pool.s_start[p + 1] - pool.s_start[p];
+			pool.max_s = (sz > pool.max_s) ? sz : pool.max_s;
+		}
+		sort_pool = &pool;
+		qsort(pool.order, pool.nparts, sizeof(int), cmp_part_size);
+		atomic_init(&pool.next, 0);
+		atomic_init(&pool.failed, 0);
+		for(t=0; t<nthreads; t++){
+			arg[t].pool = &pool;
+			arg[t].id = t;
+			pthread_create(&th[t], NULL, by_range ? merge_join_worker : hash_join_worker, &arg[t]);
+		}
+		for(t=0; t<nthreads; t++){
+			pthread_join(th[t], NULL);
+		}
+		ok = !atomic_load(&pool.failed);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	res->matches = res->checksum = 0;
+	for(t=0; t<nthreads; t++){
+		res->matches += pool.part[t].matches;
+		res->checksum += pool.part[t].checksum;
+	}
+	tm->partition_sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	tm->join_sec = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+	free(pool.r);
+	free(pool.s);
+	free(pool.r_start);
+	free(pool.s_start);
+	free(pool.order);
+	return ok ? 0 : -1;
+}
+
+int hash_join(const relation_t *r, const relation_t *s, int nthreads, join_result_t *res, join_timing_t *tm){
+	return run_join(r, s, nthreads, 0, res, tm);
+}
+
+int sort_merge_join(const relation_t *r, const relation_t *s, int nthreads, join_result_t *res, join_timing_t *tm){
+	return run_join(r, s, nthreads, 1, res, tm);
+}
+
+//benchmark data
+static unsigned long long rng = 88172645463325252ULL;
+
+static unsigned long long next_rand(void){
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+// R: n distinct random keys. S: m keys drawn from R, rank i with weight
+// 1/(i+1)^skew, so skew 0 is uniform.
+static void make_data(relation_t *r, relation_t *s, double skew){
+	double *cdf = malloc(r->n * sizeof(*cdf)), total = 0, u;
+	size_t i, lo, hi, mid;
+
+	for(i=0; i<r->n; i++){
+		//odd multiplier mod 2^32 is a bijection, so the keys are distinct
+		r->tuples[i].key = (int)((unsigned int)i * 2654435761u + 12345u);
+		r->tuples[i].payload = (int)i;
+		total += pow(i + 1.0, -skew);
+		cdf[i] = total;
+	}
+	for(i=0; i<s->n; i++){
+		if(skew == 0){
+			lo = (size_t)(next_rand() % r->n);
+		}else{
+			u = (double)(next_rand() >> 11) / 9007199254740992.0 * total;
+			for(lo=0, hi=r->n-1; lo<hi; ){
+				mid = (lo + hi) / 2;
+				if(cdf[mid] < u){
+					lo = mid + 1;
+				}else{
+					hi = mid;
+				}
+			}
+		}
+		//rank 0 is not always the smallest key, so hot keys spread out
+		s->tuples[i].key = r->tuples[(lo * 7919) % r->n].key;
+		s->tuples[i].payload = (int)(next_rand() & 0xFFFF);
+	}
+	free(cdf);
+}
+
+int main(int argc, char **argv){
+	size_t nr = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+	int nthreads = (argc > 2) ? atoi(argv[2]) : 4;
+	static const int ratios[] = {1, 4, 16};
+	static const double skews[] = {0, 0.75, 1.0, 1.25};
+	relation_t r, s;
+	join_result_t hj, smj;
+	join_timing_t thj, tsmj;
+	int a, b;
+
+	if(nthreads < 1 || nthreads > MAX_THREADS){
+		return 1;
+	}
+	r.n = nr;
+	r.tuples = malloc(nr * sizeof(tuple_t));
+	s.tuples = malloc(nr * ratios[2] * sizeof(tuple_t));
+	if(r.tuples == NULL || s.tuples == NULL){
+		return 1;
+	}
+	printf("|R| = %lu, %d threads, times in ms (partition + join)\n", (unsigned long)nr, nthreads);
+	printf("|S|/|R|  skew      matches      hash join   sort-merge join   speedup\n");
+	for(a=0; a<3; a++){
+		for(b=0; b<4; b++){
+			s.n = nr * ratios[a];
+			make_data(&r, &s, skews[b]);
+			if(hash_join(&r, &s, nthreads, &hj, &thj) != 0 || sort_merge_join(&r, &s, nthreads, &smj, &tsmj) != 0){
+				printf("Out of memory\n");
+				return 1;
+			}
+			printf("%7d %5.2f %12llu %6.0f + %5.0f   %6.0f + %6.0f %8.2fx%s\n", ratios[a], skews[b], hj.matches,
+				thj.partition_sec * 1e3, thj.join_sec * 1e3, tsmj.partition_sec * 1e3, tsmj.join_sec * 1e3,
+				(tsmj.partition_sec + tsmj.join_sec) / (thj.partition_sec + thj.join_sec),
+				(hj.matches == smj.matches && hj.checksum == smj.checksum) ? "" : "  MISMATCH");
+		}
+	}
+	free(r.tuples);
+	free(s.tuples);
+	return 0;
+}
@@ -0,0 +1,327 @@
+// hashQualityBenchmark
+// Compares djb2, sdbm and lose-lose on realistic key sets: English words,
+// URLs, UUIDs and sequential IDs. For each hash and key set it reports
+//  - throughput in GB/s and cycles per byte
+//  - bucket collisions at several table sizes, next to what a random
+//    hash would give, and the longest bucket chain
+//  - avalanche (how often each output bit flips when one input bit flips)
+//    and bias (how often each output bit is set), ideal is 0.5 for both
+// Usage: hashQualityBenchmark [keys per set] [word list file]
+// Without a word list, English-like words are built from common syllables.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+#define KEY_MAX 96
+
+typedef unsigned long (*hash_len_fn)(const unsigned char *p, size_t len);
+
+typedef struct key_set{
+	const char *name;
+	char **keys;
+	size_t *lens;
+	size_t n;
+	size_t bytes;
+} key_set_t;
+
+// Length-aware versions of djb2HashImplementation.c, sdbmHashImplementation.c
+// and loseLoseHashImplementation.c, same values for keys without a NUL byte.
+// Bit flips in the avalanche test may produce a NUL byte, so these are used
+// throughout.
+unsigned long djb2_len(const unsigned char *p, size_t len){
+	unsigned long hash = 5381;
+	while(len--){
+		hash = ((hash << 5) + hash) + *p++;
+	}
+	return hash;
+}
+
+unsigned long sdbm_len(const unsigned char *p, size_t len){
+	unsigned long hash = 0;
+	while(len--){
+		hash = *p++ + (hash << 6) + (hash << 16) - hash;
+	}
+	return hash;
+}
+
+unsigned long loselose_len(const unsigned char *p, size_t len){
+	unsigned int hash = 0;
+	while(len--){
+		hash += *p++;
+	}
+	return hash;
+}
+
+//key corpora
+static const char *syllables[] = {
+	"the", "an", "re", "in", "er", "on", "at", "en", "nd", "ti", "es", "or",
+	"te", "of", "ed", "is", "it", "al", "ar", "st", "to", "nt", "ng", "se",
+	"ha", "as", "ou", "io", "le", "ve", "co", "me", "de", "hi", "ri", "ro",
+	"ic", "ne", "ea", "ra", "ce", "li", "ch", "ll", "be", "ma", "si", "om", "ur"
+};
+
+static void random_word(char *out, size_t max){
+	int parts = 2 + rand() % 4;
+	out[0] = 0;
+	while(parts-- && strlen(out) + 3 < max){
+		strcat(out, syllables[rand() % (sizeof(syllables) / sizeof(syllables[0]))]);
+	}
+}
+
+static void set_add(key_set_t *s, const char *key){
+	size_t len = strlen(key);
+	s->keys[s->n] = malloc(len + 1);
+	memcpy(s->keys[s->n], key, len + 1);
+	s->lens[s->n] = len;
+	s->bytes += len;
+	s->n++;
+}
+
+static void set_alloc(key_set_t *s, const char *name, size_t n){
+	s->name = name;
+	s->keys = malloc(n * sizeof(*s->keys));
+	s->lens = malloc(n * sizeof(*s->lens));
+	s->n = 0;
+	s->bytes = 0;
+}
+
+static void set_free(key_set_t *s){
+	size_t i;
+	for(i=0; i<s->n; i++){
+		free(s->keys[i]);
+	}
+	free(s->keys);
+	free(s->lens);
+}
+
+static int key_cmp(const void *a, const void *b){
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Drop duplicate keys so collisions are only counted between distinct keys
+static void set_unique(key_set_t *s){
+	size_t i, j = 0;
+
+	qsort(s->keys, s->n, sizeof(*s->keys), key_cmp);
+	s->bytes = 0;
+	for(i=0; i<s->n; i++){
+		if(j > 0 && strcmp(s->keys[i], s->keys[j-1]) == 0){
+			free(s->keys[i]);
+			continue;
+		}
+		s->keys[j] = s->keys[i];
+		s->lens[j] = strlen(s->keys[j]);
+		s->bytes += s->lens[j];
+		j++;
+	}
+	s->n = j;
+}
+
+static void make_words(key_set_t *s, size_t n, const char *path){
+	char buf[KEY_MAX];
+	FILE *f = (path != NULL) ? fopen(path, "r") : NULL;
+
+	set_alloc(s, "words", n);
+	while(f != NULL && s->n < n && fgets(buf, sizeof(buf), f) != NULL){
+		buf[strcspn(buf, "\r\n")] = 0;
+		if(buf[0]){
+			set_add(s, buf);
+		}
+	}
+	if(f != NULL){
+		fclose(f);
+	}
+	set_unique(s);
+	while(s->n < n){
+		while(s->n < n){
+			random_word(buf, 24);
+			set_add(s, buf);
+		}
+		set_unique(s);
+	}
+}
+
+static void make_urls(key_set_t *s, size_t n){
+	static const char *tld[] = {"com", "org", "net", "io", "co.uk"};
+	char host[32], path[32], buf[KEY_MAX];
+
+	set_alloc(s, "urls", n);
+	while(s->n < n){
+		while(s->n < n){
+			random_word(host, 16);
+			random_word(path, 16);
+			sprintf(buf, "https://www.%s.%s/%s/%d", host, tld[rand() % 5], path, rand() % 100000);
+			set_add(s, buf);
+		}
+		set_unique(s);
+	}
+}
+
+static void make_uuids(key_set_t *s, size_t n){
+	static const char hex[] = "0123456789abcdef";
+	char buf[37];
+	int i;
+
+	set_alloc(s, "uuids", n);
+	while(s->n < n){
+		for(i=0; i<36; i++){
+			buf[i] = (i == 8 || i == 13 || i == 18 || i == 23) ? '-' : hex[rand() & 15];
+		}
+		buf[14] = '4';
+		buf[36] = 0;
+		set_add(s, buf);
+	}
+}
+
+static void make_sequential(key_set_t *s, size_t n){
+	char buf[32];
+
+	set_alloc(s, "seq ids", n);
+	while(s->n < n){
+		sprintf(buf, "id%08lu", (unsigned long)s->n);
+		set_add(s, buf);
+	}
+}
+
+//throughput
+static void bench_speed(hash_len_fn hash, const key_set_t *s){
+	size_t i, rounds = 1 + (50u << 20) / (s->bytes + 1);
+	size_t r;
+	unsigned long sink = 0;
+	clock_t start;
+	double sec;
+#ifdef HAVE_RDTSC
+	unsigned long long t0, t1;
+	t0 = __rdtsc();
+#endif
+
+	start = clock();
+	for(r=0; r<rounds; r++){
+		for(i=0; i<s->n; i++){
+			sink += hash((const unsigned char *)s->keys[i], s->lens[i]);
+		}
+	}
+	sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+#ifdef HAVE_RDTSC
+	t1 = __rdtsc();
+	printf("  %6.2f GB/s  %5.2f cycles/byte", (double)s->bytes * rounds / sec / 1e9,
+		(double)(t1 - t0) / ((double)s->bytes * rounds));
+#else
+	printf("  %6.2f GB/s  cycles/byte n/a", (double)s->bytes * rounds / sec / 1e9);
+#endif
+	printf("  (checksum %lx)\n", sink & 0xFFF);
+}
+
+// Keys that land in an already used bucket, for a table of 2^bits buckets
+// indexed by the low bits of the hash, as most simple tables do
+static void bench_collisions(hash_len_fn hash, const key_set_t *s, int bits){
+	size_t m = (size_t)1 << bits;
+	unsigned int *count = calloc(m, sizeof(*count));
+	size_t i, used = 0, longest = 0, b;
+	double expected;
+
+	if(count == NULL){
+		return;
+	}
+	for(i=0; i<s->n; i++){
+		b = hash((const unsigned char *)s->keys[i], s->lens[i]) & (m - 1);
+		if(count[b]++ == 0){
+			used++;
+		}
+		if(count[b] > longest){
+			longest = count[b];
+		}
+	}
+	//a random hash leaves m(1-1/m)^n buckets empty
+	expected = s->n - m * (1.0 - pow(1.0 - 1.0 / m, (double)s->n));
+	printf("    2^%-2d buckets: %9lu collisions (random %9.0f)  longest chain %lu\n",
+		bits, (unsigned long)(s->n - used), expected, (unsigned long)longest);
+	free(count);
+}
+
+// Avalanche: flip every bit of up to 2000 keys and count, for each output
+// bit, how often it changes. Bias: how often each output bit is set.
+// Reports the mean and the worst distance from 0.5 over the 64 output bits.
+static void bench_avalanche(hash_len_fn hash, const key_set_t *s){
+	unsigned char buf[KEY_MAX];
+	unsigned long flips[64] = {0}, set[64] = {0};
+	unsigned long h, d, trials = 0;
+	size_t i, n = (s->n < 2000) ? s->n : 2000, bit;
+	double p, mean = 0, worst = 0, bmean = 0, bworst = 0;
+	int o;
+
+	for(i=0; i<s->n; i++){
+		h = hash((const unsigned char *)s->keys[i], s->lens[i]);
+		for(o=0; o<64; o++){
+			set[o] += (h >> o) & 1;
+		}
+	}
+	for(i=0; i<n; i++){
+		memcpy(buf, s->keys[i], s->lens[i]);
+		h = hash(buf, s->lens[i]);
+		for(bit=0; bit<s->lens[i]*8; bit++){
+			buf[bit / 8] ^= 1 << (bit % 8);
+			d = h ^ hash(buf, s->lens[i]);
+			buf[bit / 8] ^= 1 << (bit % 8);
+			for(o=0; o<64; o++){
+				flips[o] += (d >> o) & 1;
+			}
+			trials++;
+		}
+	}
+	for(o=0; o<64; o++){
+		p = (double)flips[o] / trials;
+		mean += p / 64;
+		if(fabs(p - 0.5) > worst){
+			worst = fabs(p - 0.5);
+		}
+		p = (double)set[o] / s->n;
+		bmean += p / 64;
+		if(fabs(p - 0.5) > bworst){
+			bworst = fabs(p - 0.5);
+		}
+	}
+	printf("    avalanche mean %.3f worst bias %.3f   bit set mean %.3f worst bias %.3f\n",
+		mean, worst, bmean, bworst);
+}
+
+int main(int argc, char **argv){
+	size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 200000;
+	const char *words = (argc > 2) ? argv[2] : NULL;
+	const char *names[] = {"djb2", "sdbm", "loselose"};
+	hash_len_fn fns[] = {djb2_len, sdbm_len, loselose_len};
+	int table_bits[] = {10, 16, 20};
+	key_set_t sets[4];
+	int s, f, b;
+
+	srand(1);
+	make_words(&sets[0], n, words);
+	make_urls(&sets[1], n);
+	make_uuids(&sets[2], n);
+	make_sequential(&sets[3], n);
+
+	for(s=0; s<4; s++){
+		printf("\n== %s: %lu keys, %.1f bytes/key\n", sets[s].name,
+			(unsigned long)sets[s].n, (double)sets[s].bytes / sets[s].n);
+		for(f=0; f<3; f++){
+			printf("%s\n", names[f]);
+			bench_speed(fns[f], &sets[s]);
+			for(b=0; b<3; b++){
+				bench_collisions(fns[f], &sets[s], table_bits[b]);
+			}
+			bench_avalanche(fns[f], &sets[s]);
+		}
+	}
+
+	for(s=0; s<4; s++){
+		set_free(&sets[s]);
+	}
+	return 0;
+}
@@ -0,0 +1,547 @@
+// hashTableImplementation
+// Open addressing hash map with SwissTable-style metadata.
+// Every slot has a one byte control entry: EMPTY, DELETED, or the low 7
+// bits of the key's hash. Lookups load 16 control bytes at a time and
+// compare them all against the 7-bit tag with one SSE2 compare, so only
+// slots whose tag matches are ever touched. A lookup is usually one cache
+// miss for the control group and one for the slot.
+// Keys are stored by pointer, the caller owns the key memory, and slots
+// live in one flat array: no per-entry heap allocation.
+// The hash function is pluggable, any of djb2, sdbm or lose-lose.
+// Growing normally rehashes everything at once, which stalls the insert
+// that triggers it for milliseconds on a big table. In incremental mode
+// (table_init_incremental) the old arrays are kept and every put or
+// remove moves the next MIGRATE_SLOTS of them into the new ones. Until
+// they are drained, lookups that miss in the new arrays also probe the old.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GROUP_WIDTH 16
+#define CTRL_EMPTY ((signed char)-128)
+#define CTRL_DELETED ((signed char)-2)
+// Old slots moved per write while growing incrementally. Even when the
+// table is only rebuilt to clear tombstones, the new arrays take about
+// capacity/3 writes to fill, so the old ones are long drained by then.
+#define MIGRATE_SLOTS 8
+
+typedef unsigned long (*hash_fn)(unsigned char *str);
+
+typedef struct slot{
+	const char *key;
+	int val;
+} slot_t;
+
+typedef struct hash_table{
+	signed char *ctrl;	// capacity + GROUP_WIDTH bytes, the tail mirrors the first group
+	slot_t *slots;
+	size_t capacity;	// power of two, at least GROUP_WIDTH
+	size_t size;		// entries in both the new and the old arrays
+	size_t growth_left;	// inserts into EMPTY slots left before a rehash
+	hash_fn hash;
+	int incremental;
+	signed char *old_ctrl;	// arrays being drained, NULL when not growing
+	slot_t *old_slots;
+	size_t old_capacity;
+	size_t migrate_pos;	// old slots before this have been moved
+} hash_table_t;
+
+// Hash functions, same as djb2HashImplementation.c, sdbmHashImplementation.c
+// and loseLoseHashImplementation.c
+unsigned long djb2_hash(unsigned char *str){
+	unsigned long hash = 5381;
+	int c;
+
+	while((c = *str++)){
+		hash = ((hash << 5) + hash) + c;
+	}
+	return hash;
+}
+
+unsigned long sdbm_hash(unsigned char *str){
+	unsigned long hash = 0;
+	int c;
+
+	while((c = *str++)){
+		hash = c + (hash << 6) + (hash << 16) - hash;
+	}
+	return hash;
+}
+
+unsigned long loselose_hash(unsigned char *str){
+	unsigned int hash = 0;
+	int c;
+
+	while((c = *str++)){
+		hash += c;
+	}
+	return hash;
+}
+
+// Spread the hash over all 64 bits before splitting it into position and
+// tag, otherwise the short values of lose-lose would all land in the first
+// few groups
+static unsigned long long table_mix(unsigned long h){
+	unsigned long long m = (unsigned long long)h * 0x9E3779B97F4A7C15ULL;
+	return m ^ (m >> 32);
+}
+
+// Bit i of the result is set if control byte i of the group matches
+static unsigned int group_match(const signed char *g, signed char tag){
+#ifdef __SSE2__
+	__m128i ctrl = _mm_loadu_si128((const __m128i *)g);
+	return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag)));
+#else
+	unsigned int mask = 0;
+	int i;
+	for(i=0; i<GROUP_WIDTH; i++){
+		if(g[i] == tag){
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+#endif
+}
+
+// EMPTY and DELETED are the only negative control bytes
+static unsigned int group_match_free(const signed char *g){
+#ifdef __SSE2__
+	return (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)g));
+#else
+	unsigned int mask = 0;
+	int i;
+	for(i=0; i<GROUP_WIDTH; i++){
+		if(g[i] < 0){
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+#endif
+}
+
+static int lowest_bit(unsigned int mask){
+	int i = 0;
+	while(!(mask & 1)){
+		mask >>= 1;
+		i++;
+	}
+	return i;
+}
+
+static void set_ctrl(hash_table_t *t, size_t i, signed char c){
+	t->ctrl[i] = c;
+	if(i < GROUP_WIDTH){
+		t->ctrl[t->capacity + i] = c;
+	}
+}
+
+static int table_alloc(hash_table_t *t, size_t capacity){
+	t->ctrl = malloc(capacity + GROUP_WIDTH);
+	t->slots = malloc(capacity * sizeof(slot_t));
+	if(t->ctrl == NULL || t->slots == NULL){
+		free(t->ctrl);
+		free(t->slots);
+		return -1;
+	}
+	memset(t->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+	t->capacity = capacity;
+	t->size = 0;
+	t->growth_left = capacity - capacity / 8;
+	return 0;
+}
+
+int table_init(hash_table_t *t, size_t capacity, hash_fn hash){
+	size_t cap = GROUP_WIDTH;
+	while(cap - cap / 8 < capacity){
+		cap <<= 1;
+	}
+	t->hash = hash;
+	t->incremental = 0;
+	t->old_ctrl = NULL;
+	t->old_slots = NULL;
+	t->old_capacity = t->migrate_pos = 0;
+	return table_alloc(t, cap);
+}
+
+// Same as table_init, but growth is spread over the following writes
+int table_init_incremental(hash_table_t *t, size_t capacity, hash_fn hash){
+	int r = table_init(t, capacity, hash);
+	t->incremental = 1;
+	return r;
+}
+
+void table_free(hash_table_t *t){
+	free(t->ctrl);
+	free(t->slots);
+	free(t->old_ctrl);
+	free(t->old_slots);
+	t->ctrl = NULL;
+	t->slots = NULL;
+	t->old_ctrl = NULL;
+	t->old_slots = NULL;
+	t->capacity = t->size = t->growth_left = 0;
+	t->old_capacity = t->migrate_pos = 0;
+}
+
+// The arrays being drained, as a table the probe functions can search
+static hash_table_t table_old(const hash_table_t *t){
+	hash_table_t old = *t;
+	old.ctrl = t->old_ctrl;
+	old.slots = t->old_slots;
+	old.capacity = t->old_capacity;
+	return old;
+}
+
+// Probe groups of 16 slots with triangular steps, which visits every group
+// once when the capacity is a power of two. Returns the slot index or -1.
+static long table_find_index(const hash_table_t *t, const char *key, unsigned long long h){
+	size_t mask = t->capacity - 1;
+	size_t pos = (size_t)(h >> 7) & mask;
+	size_t step = 0;
+	signed char tag = (signed char)(h & 0x7F);
+	unsigned int m;
+	size_t i;
+
+	for(;;){
+		const signed char *g = t->ctrl + pos;
+		m = group_match(g, tag);
+		while(m){
+			i = (pos + lowest_bit(m)) & mask;
+			if(strcmp(t->slots[i].key, key) == 0){
+				return (long)i;
+			}
+			m &= m - 1;
+		}
+		if(group_match(g, CTRL_EMPTY)){
+			return -1;
+		}
+		step += GROUP_WIDTH;
+		pos = (pos + step) & mask;
+	}
+}
+
+// First EMPTY or DELETED slot on the probe sequence of h
+static size_t table_find_free(const hash_table_t *t, unsigned long long h){
+	size_t mask = t->capacity - 1;
+	size_t pos = (size_t)(h >> 7) & mask;
+	size_t step = 0;
+	unsigned int m;
+
+	for(;;){
+		m = group_match_free(t->ctrl + pos);
+		if(m){
+			return (pos + lowest_bit(m)) & mask;
+		}
+		step += GROUP_WIDTH;
+		pos = (pos + step) & mask;
+	}
+}
+
+// Rebuild the table, doubling it unless it is mostly tombstones
+static int table_rehash(hash_table_t *t){
+	hash_table_t old = *t;
+	size_t cap = old.capacity;
+	size_t i, j;
+	unsigned long long h;
+
+	if(old.size >= cap / 2){
+		cap <<= 1;
+	}
+	if(table_alloc(t, cap) != 0){
+		*t = old;
+		return -1;
+	}
+	for(i=0; i<old.capacity; i++){
+		if(old.ctrl[i] >= 0){
+			h = table_mix(t->hash((unsigned char *)old.slots[i].key));
+			j = table_find_free(t, h);
+			set_ctrl(t, j, (signed char)(h & 0x7F));
+			t->slots[j] = old.slots[i];
+			t->size++;
+			t->growth_left--;
+		}
+	}
+	free(old.ctrl);
+	free(old.slots);
+	return 0;
+}
+
+// Move the next n old slots into the new arrays, freeing the old arrays
+// once they are empty
+static void table_migrate(hash_table_t *t, size_t n){
+	size_t end = t->migrate_pos + n, i, j;
+	unsigned long long h;
+	hash_table_t old;
+
+	if(t->old_ctrl == NULL){
+		return;
+	}
+	old = table_old(t);
+	if(end > t->old_capacity){
+		end = t->old_capacity;
+	}
+	for(i=t->migrate_pos; i<end; i++){
+		if(t->old_ctrl[i] >= 0){
+			h = table_mix(t->hash((unsigned char *)t->old_slots[i].key));
+			j = table_find_free(t, h);
+			if(t->ctrl[j] == CTRL_EMPTY){
+				t->growth_left--;
+			}
+			set_ctrl(t, j, (signed char)(h & 0x7F));
+			t->slots[j] = t->old_slots[i];
+			//a moved key must not be found in the old arrays again
+			set_ctrl(&old, i, CTRL_DELETED);
+		}
+	}
+	t->migrate_pos = end;
+	if(end == t->old_capacity){
+		free(t->old_ctrl);
+		free(t->old_slots);
+		t->old_ctrl = NULL;
+		t->old_slots = NULL;
+		t->old_capacity = t->migrate_pos = 0;
+	}
+}
+
+// Start an incremental rehash: the current arrays become the old ones and
+// fresh arrays take new inserts
+static int table_grow_incremental(hash_table_t *t){
+	hash_table_t cur;
+	size_t cap;
+
+	//writes migrate as they go, but make sure the last drain is over
+	table_migrate(t, t->old_capacity);
+	cur = *t;
+	cap = cur.capacity;
+	if(cur.size >= cap / 2){
+		cap <<= 1;
+	}
+	if(table_alloc(t, cap) != 0){
+		*t = cur;
+		return -1;
+	}
+	t->size = cur.size;
+	t->old_ctrl = cur.ctrl;
+	t->old_slots = cur.slots;
+	t->old_capacity = cur.capacity;
+	t->migrate_pos = 0;
+	return 0;
+}
+
+// Insert or update. Returns 0 on success, -1 if out of memory.
+int table_put(hash_table_t *t, const char *key, int val){
+	unsigned long long h = table_mix(t->hash((unsigned char *)key));
+	long found;
+	size_t i;
+	hash_table_t old;
+
+	table_migrate(t, MIGRATE_SLOTS);
+	found = table_find_index(t, key, h);
+	if(found >= 0){
+		t->slots[found].val = val;
+		return 0;
+	}
+	if(t->old_ctrl != NULL){
+		old = table_old(t);
+		found = table_find_index(&old, key, h);
+		if(found >= 0){
+			t->old_slots[found].val = val;
+			return 0;
+		}
+	}
+	i = table_find_free(t, h);
+	if(t->growth_left == 0 && t->ctrl[i] == CTRL_EMPTY){
+		if((t->incremental ? table_grow_incremental(t) : table_rehash(t)) != 0){
+			return -1;
+		}
+		i = table_find_free(t, h);
+	}
+	if(t->ctrl[i] == CTRL_EMPTY){
+		t->growth_left--;
+	}
+	set_ctrl(t, i, (signed char)(h & 0x7F));
+	t->slots[i].key = key;
+	t->slots[i].val = val;
+	t->size++;
+	return 0;
+}
+
+// Returns 1 and stores the value in *val if key is present, 0 otherwise
+// Lookups never migrate, only writes move slots
+int table_get(const hash_table_t *t, const char *key, int *val){
+	unsigned long long h = table_mix(t->hash((unsigned char *)key));
+	long i = table_find_index(t, key, h);
+	const slot_t *slots = t->slots;
+	hash_table_t old;
+
+	if(i < 0 && t->old_ctrl != NULL){
+		old = table_old(t);
+		i = table_find_index(&old, key, h);
+		slots = t->old_slots;
+	}
+	if(i < 0){
+		return 0;
+	}
+	if(val != NULL){
+		*val = slots[i].val;
+	}
+	return 1;
+}
+
+// Returns 1 if key was removed, 0 if it was not present
+int table_remove(hash_table_t *t, const char *key){
+	unsigned long long h = table_mix(t->hash((unsigned char *)key));
+	long i;
+	hash_table_t old;
+
+	table_migrate(t, MIGRATE_SLOTS);
+	i = table_find_index(t, key, h);
+	if(i >= 0){
+		set_ctrl(t, (size_t)i, CTRL_DELETED);
+	}else if(t->old_ctrl != NULL){
+		old = table_old(t);
+		i = table_find_index(&old, key, h);
+		if(i >= 0){
+			set_ctrl(&old, (size_t)i, CTRL_DELETED);
+		}
+	}
+	if(i < 0){
+		return 0;
+	}
+	t->size--;
+	return 1;
+}
+
+//benchmark: insert then look up n keys with each hash function
+static void bench(const char *name, hash_fn hash, char **keys, size_t n){
+	hash_table_t t;
+	size_t i, missing = 0;
+	clock_t start;
+	double ti, tl;
+	int val;
+
+	if(table_init(&t, 0, hash) != 0){
+		return;
+	}
+	start = clock();
+	for(i=0; i<n; i++){
+		table_put(&t, keys[i], (int)i);
+	}
+	ti = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	start = clock();
+	for(i=0; i<n; i++){
+		if(!table_get(&t, keys[i], &val) || val != (int)i){
+			missing++;
+		}
+	}
+	tl = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	printf("%-9s insert %8.2f Mops/s  lookup %8.2f Mops/s  size %lu  capacity %lu  missing %lu\n",
+		name, n / ti / 1e6, n / tl / 1e6, (unsigned long)t.size,
+		(unsigned long)t.capacity, (unsigned long)missing);
+	table_free(&t);
+}
+
+static unsigned long long now_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_ull(const void *a, const void *b){
+	unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+	return (x > y) - (x < y);
+}
+
+//latency benchmark: time every operation of an insert + lookup stream on a
+//table that starts empty and grows about 20 times on the way
+static void bench_latency(const char *name, int incremental, char **keys, size_t n){
+	unsigned long long *lat = malloc(2 * n * sizeof(*lat));
+	unsigned long long t0, t1, total = 0;
+	size_t i, ops = 0, slow = 0, missing = 0;
+	unsigned long long x = 0x2545F4914F6CDD1DULL;
+	hash_table_t t;
+	int val;
+
+	if(lat == NULL || (incremental ? table_init_incremental(&t, 0, djb2_hash) : table_init(&t, 0, djb2_hash)) != 0){
+		free(lat);
+		return;
+	}
+	for(i=0; i<n; i++){
+		t0 = now_ns();
+		table_put(&t, keys[i], (int)i);
+		t1 = now_ns();
+		lat[ops++] = t1 - t0;
+
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		t0 = now_ns();
+		if(!table_get(&t, keys[x % (i + 1)], &val) || val != (int)(x % (i + 1))){
+			missing++;
+		}
+		t1 = now_ns();
+		lat[ops++] = t1 - t0;
+	}
+	for(i=0; i<ops; i++){
+		total += lat[i];
+		if(lat[i] > 1000000){
+			slow++;
+		}
+	}
+	qsort(lat, ops, sizeof(*lat), cmp_ull);
+	printf("%-12s p50 %5llu  p99 %6llu  p99.9 %7llu  p99.99 %8llu  max %9llu ns  >1ms %lu  total %.3f s  missing %lu\n",
+		name, lat[ops / 2], lat[ops / 100 * 99], lat[ops / 1000 * 999], lat[ops / 10000 * 9999],
+		lat[ops - 1], (unsigned long)slow, total / 1e9, (unsigned long)missing);
+	table_free(&t);
+	free(lat);
+}
+
+int main(int argc, char **argv){
+	size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+	size_t i;
+	char **keys = malloc(n * sizeof(*keys));
+	char *buf = malloc(n * 16);
+	hash_table_t t;
+	int val;
+
+	if(keys == NULL || buf == NULL){
+		return 1;
+	}
+
+	table_init(&t, 0, djb2_hash);
+	table_put(&t, "apple", 1);
+	table_put(&t, "pear", 2);
+	table_put(&t, "apple", 3);
+	table_remove(&t, "pear");
+	if(table_get(&t, "apple", &val)){
+		printf("apple = %d\n", val);
+	}
+	if(!table_get(&t, "pear", NULL)){
+		printf("pear removed\n");
+	}
+	table_free(&t);
+
+	for(i=0; i<n; i++){
+		keys[i] = buf + i * 16;
+		sprintf(keys[i], "key%lu", (unsigned long)i);
+	}
+	bench("djb2", djb2_hash, keys, n);
+	bench("sdbm", sdbm_hash, keys, n);
+	//lose-lose sums bytes, so most keys collide and probing gets long
+	bench("loselose", loselose_hash, keys, (n < 20000) ? n : 20000);
+
+	printf("operation latency, %lu inserts each followed by a lookup:\n", (unsigned long)n);
+	bench_latency("one-shot", 0, keys, n);
+	bench_latency("incremental", 1, keys, n);
+
+	free(keys);
+	free(buf);
+	return 0;
+}
@@ -0,0 +1,532 @@
+// intDistinctImplementation
+// Distinct values and group-by-count for int arrays with a hash table
+// instead of sort + unique.
+//  - Multiplicative hashing: the value times a 64-bit odd constant, then
+//    the top bits pick the slot.
+//  - The table is open addressing over groups of 8 keys (AVX2) or 4 keys
+//    (SSE2), with the counts in a parallel array. A probe compares the key
+//    against a whole group with one vector compare, then checks the group
+//    for an empty lane. Nothing is ever deleted, so the empty lanes of a
+//    group always come after the full ones.
+//  - INT_MIN marks an empty lane, so INT_MIN itself is counted on the side.
+//  - The parallel version radix-partitions the input by the top 8 bits of
+//    the hash. Every value lands in exactly one partition, so the
+//    partitions are counted independently, each with a table small enough
+//    to stay in cache, and the results are concatenated.
+// main() compares against qsort + unique across cardinalities, with
+// insertion sort from insertionSortImplementation.c on a small sample.
+// To run: gcc -O2 -mavx2 -pthread intDistinctImplementation.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#define GROUP 8
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define GROUP 4
+#else
+#define GROUP 4
+#endif
+
+#define EMPTY_KEY INT_MIN
+#define HASH_MUL 0x9E3779B97F4A7C15ULL
+#define BATCH 16
+#define PART_BITS 8
+#define MAX_THREADS 64
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+
+typedef struct int_count{
+	int *keys;			// ngroups * GROUP, EMPTY_KEY when free
+	unsigned int *counts;
+	size_t ngroups;			// power of two
+	size_t size;			// distinct keys in the table
+	int shift;			// group of h is (h << skip) >> shift
+	int skip;			// hash bits already used for partitioning
+	unsigned int min_count;		// occurrences of EMPTY_KEY itself
+} int_count_t;
+
+static unsigned long long int_hash(int x){
+	return (unsigned long long)(unsigned int)x * HASH_MUL;
+}
+
+static size_t group_of(const int_count_t *t, unsigned long long h){
+	return (size_t)((h << t->skip) >> t->shift);
+}
+
+static int table_alloc(int_count_t *t, size_t ngroups){
+	size_t i, bits = 0;
+	//aligned_alloc needs a size that is a multiple of the alignment, and
+	//with SSE2 two groups are only 32 bytes
+	size_t bytes = (ngroups * GROUP * sizeof(int) + 63) & ~(size_t)63;
+
+	t->keys = aligned_alloc(64, bytes);
+	t->counts = malloc(ngroups * GROUP * sizeof(unsigned int));
+	if(t->keys == NULL || t->counts == NULL){
+		free(t->keys);
+		free(t->counts);
+		return -1;
+	}
+	for(i=0; i<ngroups * GROUP; i++){
+		t->keys[i] = EMPTY_KEY;
+	}
+	while(((size_t)1 << bits) < ngroups){
+		bits++;
+	}
+	t->ngroups = ngroups;
+	t->shift = 64 - (int)bits;
+	return 0;
+}
+
+// expected is a hint for the number of distinct keys. skip is the number
+// of top hash bits that are the same for every key, 0 unless the input
+// was partitioned by them.
+int int_count_init(int_count_t *t, size_t expected, int skip){
+	size_t ngroups = 2;
+
+	while(ngroups * GROUP < expected * 2){
+		ngroups <<= 1;
+	}
+	t->size = 0;
+	t->skip = skip;
+	t->min_count = 0;
+	return table_alloc(t, ngroups);
+}
+
+void int_count_free(int_count_t *t){
+	free(t->keys);
+	free(t->counts);
+	t->keys = NULL;
+	t->counts = NULL;
+	t->ngroups = t->size = 0;
+}
+
+// Bit i set if lane i of the group holds k
+static unsigned int group_match(const int *g, int k){
+#ifdef __AVX2__
+	__m256i v = _mm256_load_si256((const __m256i *)g);
+	return (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, _mm256_set1_epi32(k))));
+#elif defined(__SSE2__)
+	__m128i v = _mm_load_si128((const __m128i *)g);
+	return (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, _mm_set1_epi32(k))));
+#else
+	unsigned int m = 0;
+	int i;
+	for(i=0; i<GROUP; i++){
+		m |= (unsigned int)(g[i] == k) << i;
+	}
+	return m;
+#endif
+}
+
+static int lowest_bit(unsigned int mask){
+	int i = 0;
+	while(!(mask & 1)){
+		mask >>= 1;
+		i++;
+	}
+	return i;
+}
+
+// Place a key known to be new, for growing
+static void table_place(int_count_t *t, int k, unsigned int count){
+	size_t g = group_of(t, int_hash(k)), mask = t->ngroups - 1, i;
+	unsigned int m;
+
+	for(;;){
+		m = group_match(t->keys + g * GROUP, EMPTY_KEY);
+		if(m){
+			i = g * GROUP + lowest_bit(m);
+			t->keys[i] = k;
+			t->counts[i] = count;
+			return;
+		}
+		g = (g + 1) & mask;
+	}
+}
+
+static int table_grow(int_count_t *t){
+	int_count_t old = *t;
+	size_t i;
+
+	if(table_alloc(t, old.ngroups * 2) != 0){
+		*t = old;
+		return -1;
+	}
+	for(i=0; i<old.ngroups * GROUP; i++){
+		if(old.keys[i] != EMPTY_KEY){
+			table_place(t, old.keys[i], old.counts[i]);
+		}
+	}
+	free(old.keys);
+	free(old.counts);
+	return 0;
+}
+
+// Count one occurrence of k whose hash is h
+static int table_add_hash(int_count_t *t, int k, unsigned long long h){
+	size_t g = group_of(t, h), mask = t->ngroups - 1, i;
+	unsigned int m;
+
+	if(k == EMPTY_KEY){
+		t->min_count++;
+		return 0;
+	}
+	for(;;){
+		m = group_match(t->keys + g * GROUP, k);
+		if(m){
+			t->counts[g * GROUP + lowest_bit(m)]++;
+			return 0;
+		}
+		m = group_match(t->keys + g * GROUP, EMPTY_KEY);
+		if(m){
+			i = g * GROUP + lowest_bit(m);
+			t->keys[i] = k;
+			t->counts[i] = 1;
+			//keep the table at most half full
+			if(++t->size * 2 > t->ngroups * GROUP){
+				return table_grow(t);
+			}
+			return 0;
+		}
+		g = (g + 1) & mask;
+	}
+}
+
+int int_count_add(int_count_t *t, int k){
+	return table_add_hash(t, k, int_hash(k));
+}
+
+// Count every value of arr. Hashes a block ahead and prefetches its
+// groups, so the cache misses of a large table overlap.
+int int_count_add_array(int_count_t *t, const int *arr, size_t n){
+	unsigned long long h[BATCH];
+	size_t i, j, m;
+
+	for(i=0; i<n; i+=BATCH){
+		m = (n - i < BATCH) ? n - i : BATCH;
+		for(j=0; j<m; j++){
+			h[j] = int_hash(arr[i + j]);
+			PREFETCH(t->keys + group_of(t, h[j]) * GROUP);
+		}
+		for(j=0; j<m; j++){
+			if(table_add_hash(t, arr[i + j], h[j]) != 0){
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+// Copy out the distinct keys and their counts, in table order. Returns
+// the number of distinct keys.
+size_t int_count_collect(const int_count_t *t, int *keys, unsigned int *counts){
+	size_t i, d = 0;
+
+	for(i=0; i<t->ngroups * GROUP; i++){
+		if(t->keys[i] != EMPTY_KEY){
+			keys[d] = t->keys[i];
+			counts[d++] = t->counts[i];
+		}
+	}
+	if(t->min_count){
+		keys[d] = EMPTY_KEY;
+		counts[d++] = t->min_count;
+	}
+	return d;
+}
+
+// Distinct values of arr[0..n) and how often each occurs. keys and counts
+// need room for n entries. Returns the number of distinct values, or
+// (size_t)-1 if out of memory.
+size_t int_distinct(const int *arr, size_t n, int *keys, unsigned int *counts){
+	int_count_t t;
+	size_t d;
+
+	if(int_count_init(&t, 1024, 0) != 0){
+		return (size_t)-1;
+	}
+	if(int_count_add_array(&t, arr, n) != 0){
+		int_count_free(&t);
+		return (size_t)-1;
+	}
+	d = int_count_collect(&t, keys, counts);
+	int_count_free(&t);
+	return d;
+}
+
+//parallel
+#define NPART (1 << PART_BITS)
+
+typedef struct distinct_job{
+	const int *arr;
+	size_t start, end;
+	size_t hist[NPART];		// values per partition, then write offsets
+	struct distinct_shared *s;
+} distinct_job_t;
+
+typedef struct distinct_shared{
+	int *scratch;			// the input, grouped by partition
+	size_t part_start[NPART + 1];
+	size_t part_distinct[NPART];
+	int *keys;
+	unsigned int *counts;
+	atomic_int next;
+	atomic_int failed;
+	pthread_barrier_t barrier;
+} distinct_shared_t;
+
+static int part_of(int x){
+	return (int)(int_hash(x) >> (64 - PART_BITS));
+}
+
+static void *distinct_worker(void *arg){
+	distinct_job_t *j = arg;
+	distinct_shared_t *s = j->s;
+	int_count_t t;
+	size_t i, len;
+	int p;
+
+	for(i=j->start; i<j->end; i++){
+		j->hist[part_of(j->arr[i])]++;
+	}
+	pthread_barrier_wait(&s->barrier);	// main turns the histograms into offsets
+	pthread_barrier_wait(&s->barrier);
+	for(i=j->start; i<j->end; i++){
+		s->scratch[j->hist[part_of(j->arr[i])]++] = j->arr[i];
+	}
+	pthread_barrier_wait(&s->barrier);
+
+	//count whole partitions, writing each one's result where its values were
+	while((p = atomic_fetch_add(&s->next, 1)) < NPART){
+		len = s->part_start[p + 1] - s->part_start[p];
+		if(int_count_init(&t, (len < 4096) ? len : 4096, PART_BITS) != 0){
+			atomic_store(&s->failed, 1);
+			continue;
+		}
+		if(int_count_add_array(&t, s->scratch + s->part_start[p], len) != 0){
+			atomic_store(&s->failed, 1);
+			int_count_free(&t);
+			continue;
+		}
+		s->part_distinct[p] = int_count_collect(&t, s->keys + s->part_start[p], s->counts + s->part_start[p]);
+		int_count_free(&t);
+	}
+	return NULL;
+}
+
+// Same as int_distinct, with nthreads threads
+size_t int_distinct_parallel(const int *arr, size_t n, int nthreads, int *keys, unsigned int *counts){
+	distinct_job_t *job = calloc(nthreads, sizeof(*job));
+	distinct_shared_t s;
+	pthread_t th[MAX_THREADS];
+	size_t off, d, c;
+	int t, p;
+
+	if(nthreads < 1 || nthreads > MAX_THREADS || job == NULL){
+		free(job);
+		return (size_t)-1;
+	}
+	s.scratch = malloc(n * sizeof(int) + 1);
+	if(s.scratch == NULL){
+		free(job);
+		return (size_t)-1;
+	}
+	s.keys = keys;
+	s.counts = counts;
+	atomic_init(&s.next, 0);
+	atomic_init(&s.failed, 0);
+	pthread_barrier_init(&s.barrier, NULL, nthreads + 1);
+	for(t=0; t<nthreads; t++){
+		job[t].arr = arr;
+		job[t].start = n / nthreads * t;
+		job[t].end = (t == nthreads - 1) ? n : n / nthreads * (t + 1);
+		job[t].s = &s;
+		pthread_create(&th[t], NULL, distinct_worker, &job[t]);
+	}
+
+	pthread_barrier_wait(&s.barrier);
+	for(p=0, off=0; p<NPART; p++){
+		s.part_start[p] = off;
+		for(t=0; t<nthreads; t++){
+			c = job[t].hist[p];
+			job[t].hist[p] = off;
+			off += c;
+		}
+	}
+	s.part_start[NPART] = off;
+	pthread_barrier_wait(&s.barrier);
+	pthread_barrier_wait(&s.barrier);
+	for(t=0; t<nthreads; t++){
+		pthread_join(th[t], NULL);
+	}
+	pthread_barrier_destroy(&s.barrier);
+
+	//close the gaps between the partitions' results
+	d = 0;
+	if(!atomic_load(&s.failed)){
+		for(p=0; p<NPART; p++){
+			memmove(keys + d, keys + s.part_start[p], s.part_distinct[p] * sizeof(*keys));
+			memmove(counts + d, counts + s.part_start[p], s.part_distinct[p] * sizeof(*counts));
+			d += s.part_distinct[p];
+		}
+	}else{
+		d = (size_t)-1;
+	}
+	free(s.scratch);
+	free(job);
+	return d;
+}
+
+//benchmark
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_int(const void *a, const void *b){
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+// Sort, then one pass that counts runs
+static size_t sort_unique(int *arr, size_t n, int *keys, unsigned int *counts){
+	size_t i, d = 0;
+
+	qsort(arr, n, sizeof(int), cmp_int);
+	for(i=0; i<n; i++){
+		if(d == 0 || keys[d - 1] != arr[i]){
+			keys[d] = arr[i];
+			counts[d++] = 0;
+		}
+		counts[d - 1]++;
+	}
+	return d;
+}
+
+static void insertion_sort(int *arr, size_t n){
+	size_t i, j;
+	int key;
+
+	for(i=1; i<n; i++){
+		key = arr[i];
+		for(j=i; j>0 && arr[j - 1] > key; j--){
+			arr[j] = arr[j - 1];
+		}
+		arr[j] = key;
+	}
+}
+
+typedef struct pair{
+	int key;
+	unsigned int count;
+} pair_t;
+
+static int cmp_pair(const void *a, const void *b){
+	return cmp_int(&((const pair_t *)a)->key, &((const pair_t *)b)->key);
+}
+
+// Hash results come out in table order; sort them to compare with the
+// sorted results
+static int same_result(const int *k1, const unsigned int *c1, size_t d1, const int *k2, const unsigned int *c2, size_t d2){
+	pair_t *p = malloc(d1 * sizeof(*p) + 1);
+	size_t i;
+	int ok = (d1 == d2 && p != NULL);
+
+	for(i=0; ok && i<d1; i++){
+		p[i].key = k1[i];
+		p[i].count = c1[i];
+	}
+	if(ok){
+		qsort(p, d1, sizeof(*p), cmp_pair);
+	}
+	for(i=0; ok && i<d1; i++){
+		ok = (p[i].key == k2[i] && p[i].count == c2[i]);
+	}
+	free(p);
+	return ok;
+}
+
+int main(int argc, char **argv){
+	size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000000;
+	int nthreads = (argc > 2) ? atoi(argv[2]) : 4;
+	static const size_t card[] = {16, 1000, 100000, 1000000, 10000000};
+	size_t sample = (n < 20000) ? n : 20000;
+	int *arr = malloc(n * sizeof(int)), *copy = malloc(n * sizeof(int)), *domain;
+	int *k1 = malloc(n * sizeof(int)), *k2 = malloc(n * sizeof(int));
+	unsigned int *c1 = malloc(n * sizeof(int)), *c2 = malloc(n * sizeof(int));
+	unsigned long long x = 88172645463325252ULL;
+	size_t c, i, d1, d2, d3;
+	double th, tp, ts, tsi;
+	int ok;
+
+	if(arr == NULL || copy == NULL || k1 == NULL || k2 == NULL || c1 == NULL || c2 == NULL
+			|| nthreads < 1 || nthreads > MAX_THREADS){
+		return 1;
+	}
+	printf("%lu ints, %d threads, ns per value (insertion sort on %lu values)\n",
+		(unsigned long)n, nthreads, (unsigned long)sample);
+	printf("%10s %10s %10s %10s %10s %12s\n", "distinct", "hash", "parallel", "qsort", "insertion", "");
+	for(c=0; c<sizeof(card)/sizeof(card[0]); c++){
+		//card[c] random values, INT_MIN among them, drawn uniformly
+		domain = malloc(card[c] * sizeof(int));
+		if(domain == NULL){
+			return 1;
+		}
+		for(i=0; i<card[c]; i++){
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+			domain[i] = (i == 0) ? INT_MIN : (int)(unsigned int)(x >> 32);
+		}
+		for(i=0; i<n; i++){
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+			arr[i] = domain[(x >> 11) % card[c]];
+		}
+		free(domain);
+
+		th = now();
+		d1 = int_distinct(arr, n, k1, c1);
+		th = now() - th;
+
+		memcpy(copy, arr, n * sizeof(int));
+		ts = now();
+		d2 = sort_unique(copy, n, k2, c2);
+		ts = now() - ts;
+		ok = same_result(k1, c1, d1, k2, c2, d2);
+
+		tp = now();
+		d3 = int_distinct_parallel(arr, n, nthreads, k1, c1);
+		tp = now() - tp;
+		ok = ok && same_result(k1, c1, d3, k2, c2, d2);
+
+		memcpy(copy, arr, sample * sizeof(int));
+		tsi = now();
+		insertion_sort(copy, sample);
+		tsi = now() - tsi;
+
+		printf("%10lu %10.1f %10.1f %10.1f %10.1f %12s\n", (unsigned long)d2, th / n * 1e9, tp / n * 1e9,
+			ts / n * 1e9, tsi / sample * 1e9, ok ? "" : "MISMATCH");
+	}
+
+	free(arr);
+	free(copy);
+	free(k1);
+	free(k2);
+	free(c1);
+	free(c2);
+	return 0;
+}
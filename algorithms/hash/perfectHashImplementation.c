@@ -0,0 +1,406 @@
+// perfectHashImplementation
+// Minimal perfect hash for a fixed key set, CHD (compress, hash, displace)
+// style, seeded from djb2 and sdbm.
+// Keys are split into about n/5 buckets. Every key gets two hashes f1, f2
+// and bucket b is given a displacement (d0, d1) so that
+//     index = (f1 + d0 * f2 + d1) mod n
+// sends all of its keys to distinct free slots. Big buckets are placed
+// first while the table is empty; a bucket of one key always fits with
+// d0 = 0. A lookup is one displacement load and one compare: one probe,
+// and 32 bits per bucket is about 6.4 bits per key.
+// Usage:
+//     perfectHashImplementation [keyfile]              build, verify, print stats
+//     perfectHashImplementation -h out.h name [keyfile] also write a C header
+// Without a key file the C keywords are used.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PH_LAMBDA 5		// average keys per bucket
+#define PH_MAX_D0 64		// d0 tried per bucket before trying a new seed
+#define PH_MAX_SEEDS 32
+
+typedef struct perfect_hash{
+	unsigned int n;		// number of keys, also the table size
+	unsigned int buckets;
+	unsigned int seed;
+	unsigned int *disp;	// d0 * n + d1 per bucket
+} perfect_hash_t;
+
+// Length-aware djb2HashImplementation.c and sdbmHashImplementation.c, in 64
+// bits whatever the width of long, so that the generated header (which
+// uses unsigned long long too) finds the same slots on every platform
+unsigned long long djb2_len(const unsigned char *p, size_t len){
+	unsigned long long hash = 5381;
+	while(len--){
+		hash = ((hash << 5) + hash) + *p++;
+	}
+	return hash;
+}
+
+unsigned long long sdbm_len(const unsigned char *p, size_t len){
+	unsigned long long hash = 0;
+	while(len--){
+		hash = *p++ + (hash << 6) + (hash << 16) - hash;
+	}
+	return hash;
+}
+
+// 64-bit finalizer, so that every bit of the seed reaches every output bit
+static unsigned long long ph_mix(unsigned long long x){
+	x ^= x >> 33;
+	x *= 0xFF51AFD7ED558CCDULL;
+	x ^= x >> 33;
+	x *= 0xC4CEB9FE1A85EC53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+// Bucket and the two slot hashes of a key, under a given seed
+static void ph_hashes(const char *key, unsigned int seed, unsigned int n, unsigned int buckets,
+		unsigned int *b, unsigned int *f1, unsigned int *f2){
+	size_t len = strlen(key);
+	unsigned long long h = djb2_len((const unsigned char *)key, len);
+	unsigned long long g = sdbm_len((const unsigned char *)key, len);
+	unsigned long long s = ph_mix(seed + 1);
+
+	*b = (unsigned int)(ph_mix(h ^ s) % buckets);
+	*f1 = (unsigned int)(ph_mix(g ^ s) % n);
+	*f2 = (unsigned int)(ph_mix(h + g + s) % n);
+}
+
+static unsigned int ph_slot(unsigned int disp, unsigned int f1, unsigned int f2, unsigned int n){
+	unsigned long long d0 = disp / n, d1 = disp % n;
+	return (unsigned int)((f1 + d0 * f2 + d1) % n);
+}
+
+// Index of key in 0..n-1. Keys outside the set also get an index, so the
+// caller compares against the key stored there.
+unsigned int perfect_hash_lookup(const perfect_hash_t *ph, const char *key){
+	unsigned int b, f1, f2;
+	ph_hashes(key, ph->seed, ph->n, ph->buckets, &b, &f1, &f2);
+	return ph_slot(ph->disp[b], f1, f2, ph->n);
+}
+
+typedef struct ph_key{
+	unsigned int bucket, f1, f2;
+} ph_key_t;
+
+// qsort has no context argument, so the key hashes and bucket sizes for
+// the comparison are passed in these
+static const ph_key_t *ph_sort_keys;
+static const unsigned int *ph_sort_size;
+
+// Sort key indices by bucket size, biggest first, then by bucket
+static int ph_cmp(const void *a, const void *b){
+	unsigned int ba = ph_sort_keys[*(const unsigned int *)a].bucket;
+	unsigned int bb = ph_sort_keys[*(const unsigned int *)b].bucket;
+	if(ph_sort_size[ba] != ph_sort_size[bb]){
+		return (ph_sort_size[ba] > ph_sort_size[bb]) ? -1 : 1;
+	}
+	return (ba > bb) - (ba < bb);
+}
+
+// One attempt with a fixed seed. Returns 0 on success, 1 to retry with
+// another seed, -1 if out of memory.
+static int ph_try(perfect_hash_t *ph, char **keys, ph_key_t *k, unsigned int *order,
+		unsigned int *size, unsigned char *taken, unsigned int *slots){
+	unsigned int n = ph->n, i, j, start, end, cnt, b, d0, d1, s = 0;
+
+	memset(size, 0, ph->buckets * sizeof(*size));
+	memset(taken, 0, n);
+	memset(ph->disp, 0, ph->buckets * sizeof(*ph->disp));
+	for(i=0; i<n; i++){
+		ph_hashes(keys[i], ph->seed, n, ph->buckets, &k[i].bucket, &k[i].f1, &k[i].f2);
+		size[k[i].bucket]++;
+		order[i] = i;
+	}
+	ph_sort_keys = k;
+	ph_sort_size = size;
+	qsort(order, n, sizeof(*order), ph_cmp);
+
+	for(start=0; start<n; start=end){
+		b = k[order[start]].bucket;
+		for(end=start; end<n && k[order[end]].bucket == b; end++);
+		cnt = end - start;
+
+		if(cnt == 1){
+			//any free slot will do, reach it through d1 alone. Slots are
+			//never freed again, so the scan resumes where it stopped.
+			while(taken[s]){
+				s++;
+			}
+			ph->disp[b] = (s + n - k[order[start]].f1) % n;
+			taken[s] = 1;
+			continue;
+		}
+		for(d0=0; d0<PH_MAX_D0; d0++){
+			if((unsigned long long)d0 * n + n > 0xFFFFFFFFULL){
+				return 1;
+			}
+			for(d1=0; d1<n; d1++){
+				for(j=0; j<cnt; j++){
+					ph_key_t *kk = &k[order[start + j]];
+					slots[j] = ph_slot(d0 * n + d1, kk->f1, kk->f2, n);
+					if(taken[slots[j]]){
+						break;
+					}
+					taken[slots[j]] = 2;	// tentatively, to catch collisions inside the bucket
+				}
+				if(j == cnt){
+					break;
+				}
+				while(j--){
+					taken[slots[j]] = 0;
+				}
+			}
+			if(d1 < n){
+				break;
+			}
+		}
+		if(d0 == PH_MAX_D0){
+			return 1;
+		}
+		for(j=0; j<cnt; j++){
+			taken[slots[j]] = 1;
+		}
+		ph->disp[b] = d0 * n + d1;
+	}
+	return 0;
+}
+
+// Build a minimal perfect hash over n distinct keys. Returns 0 on success.
+int perfect_hash_build(perfect_hash_t *ph, char **keys, unsigned int n){
+	ph_key_t *k = malloc(n * sizeof(*k));
+	unsigned int *order = malloc(n * sizeof(*order));
+	unsigned int *slots = malloc(n * sizeof(*slots));
+	unsigned char *taken = malloc(n);
+	unsigned int *size;
+	int r = -1;
+
+	ph->n = n;
+	ph->buckets = (n + PH_LAMBDA - 1) / PH_LAMBDA;
+	ph->disp = malloc(ph->buckets * sizeof(*ph->disp));
+	size = malloc(ph->buckets * sizeof(*size));
+	if(n > 0 && k != NULL && order != NULL && slots != NULL && taken != NULL && ph->disp != NULL && size != NULL){
+		for(ph->seed=0; ph->seed<PH_MAX_SEEDS; ph->seed++){
+			r = ph_try(ph, keys, k, order, size, taken, slots);
+			if(r <= 0){
+				break;
+			}
+		}
+	}
+	if(r != 0){
+		free(ph->disp);
+		ph->disp = NULL;
+	}
+	free(k);
+	free(order);
+	free(slots);
+	free(taken);
+	free(size);
+	return (r == 0) ? 0 : -1;
+}
+
+void perfect_hash_free(perfect_hash_t *ph){
+	free(ph->disp);
+	ph->disp = NULL;
+}
+
+// Write a self-contained C header: the displacement table, the keys in
+// slot order, and a lookup function returning the slot or -1
+int perfect_hash_write_header(const perfect_hash_t *ph, char **keys, const char *path, const char *name){
+	FILE *f = fopen(path, "w");
+	const char **by_slot = malloc(ph->n * sizeof(*by_slot));
+	unsigned int i;
+	const char *c;
+
+	if(f == NULL || by_slot == NULL){
+		if(f != NULL){
+			fclose(f);
+		}
+		free(by_slot);
+		return -1;
+	}
+	for(i=0; i<ph->n; i++){
+		by_slot[perfect_hash_lookup(ph, keys[i])] = keys[i];
+	}
+
+	fprintf(f, "// Generated by perfectHashImplementation, do not edit\n");
+	fprintf(f, "#ifndef %s_PERFECT_HASH_H\n#define %s_PERFECT_HASH_H\n\n", name, name);
+	fprintf(f, "#include <string.h>\n\n");
+	fprintf(f, "#define %s_COUNT %u\n#define %s_BUCKETS %u\n\n", name, ph->n, name, ph->buckets);
+	fprintf(f, "static const unsigned int %s_disp[%u] = {", name, ph->buckets);
+	for(i=0; i<ph->buckets; i++){
+		fprintf(f, "%s%u,", (i % 8) ? " " : "\n\t", ph->disp[i]);
+	}
+	fprintf(f, "\n};\n\nstatic const char *const %s_keys[%u] = {", name, ph->n);
+	for(i=0; i<ph->n; i++){
+		fprintf(f, "\n\t\"");
+		for(c=by_slot[i]; *c; c++){
+			if(*c == '"' || *c == '\\'){
+				fputc('\\', f);
+			}
+			fputc(*c, f);
+		}
+		fprintf(f, "\",");
+	}
+	fprintf(f, "\n};\n\n");
+	fprintf(f, "static unsigned long long %s_mix(unsigned long long x){\n"
+		"\tx ^= x >> 33;\n\tx *= 0xFF51AFD7ED558CCDULL;\n\tx ^= x >> 33;\n"
+		"\tx *= 0xC4CEB9FE1A85EC53ULL;\n\tx ^= x >> 33;\n\treturn x;\n}\n\n", name);
+	fprintf(f, "// Slot of key in %s_keys, or -1 if key is not in the set\n", name);
+	fprintf(f, "static int %s_lookup(const char *key){\n", name);
+	fprintf(f, "\tunsigned long long h = 5381, g = 0;\n"
+		"\tunsigned long long s = %s_mix(%uULL), d0, d1;\n"
+		"\tconst unsigned char *p = (const unsigned char *)key;\n"
+		"\tunsigned int disp, f1, f2, slot;\n\n"
+		"\tfor(; *p; p++){\n"
+		"\t\th = ((h << 5) + h) + *p;\n"
+		"\t\tg = *p + (g << 6) + (g << 16) - g;\n"
+		"\t}\n", name, ph->seed + 1);
+	fprintf(f, "\tdisp = %s_disp[%s_mix(h ^ s) %% %uu];\n", name, name, ph->buckets);
+	fprintf(f, "\tf1 = (unsigned int)(%s_mix(g ^ s) %% %uu);\n", name, ph->n);
+	fprintf(f, "\tf2 = (unsigned int)(%s_mix(h + g + s) %% %uu);\n", name, ph->n);
+	fprintf(f, "\td0 = disp / %uu;\n\td1 = disp %% %uu;\n", ph->n, ph->n);
+	fprintf(f, "\tslot = (unsigned int)((f1 + d0 * f2 + d1) %% %uu);\n", ph->n);
+	fprintf(f, "\treturn (strcmp(%s_keys[slot], key) == 0) ? (int)slot : -1;\n}\n\n", name);
+	fprintf(f, "#endif\n");
+
+	free(by_slot);
+	return fclose(f);
+}
+
+static const char *c_keywords[] = {
+	"auto", "break", "case", "char", "const", "continue", "default", "do",
+	"double", "else", "enum", "extern", "float", "for", "goto", "if",
+	"inline", "int", "long", "register", "restrict", "return", "short",
+	"signed", "sizeof", "static", "struct", "switch", "typedef", "union",
+	"unsigned", "void", "volatile", "while"
+};
+
+static void free_keys(char **keys, unsigned int n){
+	unsigned int i;
+
+	for(i=0; i<n; i++){
+		free(keys[i]);
+	}
+	free(keys);
+}
+
+// One key per line, empty lines skipped. Returns NULL if the file cannot
+// be read, a line is longer than 255 bytes or memory runs out.
+static char **read_keys(const char *path, unsigned int *n){
+	FILE *f = fopen(path, "r");
+	char buf[256];
+	char **keys = NULL, **grown;
+	unsigned int cap = 0;
+	size_t len;
+	int ok = 1, c;
+
+	*n = 0;
+	if(f == NULL){
+		return NULL;
+	}
+	while(ok && fgets(buf, sizeof(buf), f) != NULL){
+		len = strlen(buf);
+		//a full buffer with no newline is a long line, unless the line or
+		//the file ends right after it; the end is left for the next read
+		if(len == sizeof(buf) - 1 && buf[len - 1] != '\n'){
+			c = ungetc(fgetc(f), f);
+		}else{
+			c = EOF;
+		}
+		if(c != EOF && c != '\n' && c != '\r'){
+			printf("Key %u is longer than %u bytes\n", *n + 1, (unsigned int)sizeof(buf) - 1);
+			ok = 0;
+			break;
+		}
+		buf[strcspn(buf, "\r\n")] = 0;
+		if(buf[0] == 0){
+			continue;
+		}
+		if(*n == cap){
+			cap = cap ? cap * 2 : 1024;
+			grown = realloc(keys, cap * sizeof(*keys));
+			if(grown == NULL){
+				ok = 0;
+				break;
+			}
+			keys = grown;
+		}
+		keys[*n] = malloc(strlen(buf) + 1);
+		if(keys[*n] == NULL){
+			ok = 0;
+			break;
+		}
+		strcpy(keys[(*n)++], buf);
+	}
+	fclose(f);
+	if(!ok){
+		free_keys(keys, *n);
+		*n = 0;
+		return NULL;
+	}
+	return keys;
+}
+
+int main(int argc, char **argv){
+	const char *header = NULL, *name = "keywords", *file = NULL;
+	char **keys;
+	unsigned int n, i, bad = 0;
+	unsigned char *seen;
+	perfect_hash_t ph;
+
+	if(argc > 3 && strcmp(argv[1], "-h") == 0){
+		header = argv[2];
+		name = argv[3];
+		file = (argc > 4) ? argv[4] : NULL;
+	}else if(argc > 1){
+		file = argv[1];
+	}
+
+	if(file != NULL){
+		keys = read_keys(file, &n);
+		if(keys == NULL){
+			printf("Could not read %s\n", file);
+			return 1;
+		}
+	}else{
+		keys = (char **)c_keywords;
+		n = sizeof(c_keywords) / sizeof(c_keywords[0]);
+	}
+
+	if(perfect_hash_build(&ph, keys, n) != 0){
+		printf("Build failed, are the keys distinct?\n");
+		if(file != NULL){
+			free_keys(keys, n);
+		}
+		return 1;
+	}
+	seen = calloc(n, 1);
+	for(i=0; i<n; i++){
+		unsigned int s = perfect_hash_lookup(&ph, keys[i]);
+		if(s >= n || seen[s]++){
+			bad++;
+		}
+	}
+	printf("%u keys, %u buckets, seed %u, %.2f bits per key, %u bad slots\n",
+		n, ph.buckets, ph.seed, 32.0 * ph.buckets / n, bad);
+
+	if(header != NULL){
+		if(perfect_hash_write_header(&ph, keys, header, name) != 0){
+			printf("Could not write %s\n", header);
+			return 1;
+		}
+		printf("Wrote %s\n", header);
+	}
+
+	free(seen);
+	perfect_hash_free(&ph);
+	if(file != NULL){
+		free_keys(keys, n);
+	}
+	return 0;
+}
@@ -1,15 +1,66 @@
-static unsigned long;
+#include <stddef.h>
 
-sdbm(str);
-
-unsigned char *str;
+unsigned long sdbm(unsigned char *str)
 {
 	unsigned long hash = 0;
 	int c;
-	
-	while(c = *str++){
+
+	while((c = *str++)){
 		hash = c + (hash << 6) + (hash << 16) - hash;
 	}
-	
+
+	return hash;
+}
+
+// (hash << 6) + (hash << 16) - hash is hash * 65599, so 8 bytes can be
+// folded in at once with the powers of 65599 below
+#define SDBM_P1 65599UL
+#define SDBM_P2 (SDBM_P1 * SDBM_P1)
+#define SDBM_P3 (SDBM_P2 * SDBM_P1)
+#define SDBM_P4 (SDBM_P2 * SDBM_P2)
+#define SDBM_P5 (SDBM_P4 * SDBM_P1)
+#define SDBM_P6 (SDBM_P4 * SDBM_P2)
+#define SDBM_P7 (SDBM_P4 * SDBM_P3)
+#define SDBM_P8 (SDBM_P4 * SDBM_P4)
+
+typedef struct sdbm_state{
+	unsigned long hash;
+} sdbm_state_t;
+
+// Continue an sdbm hash over len bytes, 8 bytes per step
+unsigned long sdbm_update_hash(unsigned long hash, const unsigned char *p, size_t len)
+{
+	while(len >= 8){
+		hash = hash * SDBM_P8
+			+ (p[0] * SDBM_P7 + p[1] * SDBM_P6 + p[2] * SDBM_P5 + p[3] * SDBM_P4)
+			+ (p[4] * SDBM_P3 + p[5] * SDBM_P2 + p[6] * SDBM_P1 + p[7]);
+		p += 8;
+		len -= 8;
+	}
+	while(len--){
+		hash = *p++ + (hash << 6) + (hash << 16) - hash;
+	}
 	return hash;
-}
\ No newline at end of file
+}
+
+// Length-aware sdbm, same value as sdbm() for keys without a NUL byte
+unsigned long sdbm_len(const unsigned char *p, size_t len)
+{
+	return sdbm_update_hash(0, p, len);
+}
+
+//streaming interface, feed the input in chunks of any size
+void sdbm_init(sdbm_state_t *state)
+{
+	state->hash = 0;
+}
+
+void sdbm_update(sdbm_state_t *state, const void *data, size_t len)
+{
+	state->hash = sdbm_update_hash(state->hash, (const unsigned char *)data, len);
+}
+
+unsigned long sdbm_final(const sdbm_state_t *state)
+{
+	return state->hash;
+}
@@ -0,0 +1,242 @@
+// stringInternImplementation
+// String interning pool. Every distinct string is stored once, packed
+// into large arena blocks with a bump pointer, and gets a stable 32-bit
+// ID. Interning the same text again returns the same ID, so comparing
+// strings becomes comparing integers. Strings never move once stored.
+// The index is open addressing over IDs, keyed by djb2, with the hash of
+// every entry kept so that growth never rehashes a string.
+// main() interns a stream full of repeats and reports memory against
+// one strdup per string.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ARENA_BLOCK (64 * 1024)
+#define INTERN_NONE 0xFFFFFFFFu
+
+typedef struct arena_block{
+	struct arena_block *next;
+	size_t used, size;
+	char data[];
+} arena_block_t;
+
+typedef struct intern_entry{
+	const char *str;
+	unsigned int len;
+	unsigned int hash;
+} intern_entry_t;
+
+typedef struct intern_pool{
+	arena_block_t *blocks;		// newest first
+	intern_entry_t *entries;	// indexed by ID
+	unsigned int count, entries_cap;
+	unsigned int *index;		// ID + 1 per slot, 0 is empty
+	unsigned int index_cap;		// power of two
+	size_t arena_bytes;		// bytes reserved for blocks
+} intern_pool_t;
+
+// Length-aware djb2HashImplementation.c
+unsigned long djb2_len(const unsigned char *p, size_t len){
+	unsigned long hash = 5381;
+	while(len--){
+		hash = ((hash << 5) + hash) + *p++;
+	}
+	return hash;
+}
+
+// Bump allocate len bytes, opening a new block when the current one is
+// full. Strings longer than a block get a block of their own.
+static char *arena_alloc(intern_pool_t *p, size_t len){
+	arena_block_t *b = p->blocks;
+	size_t size;
+
+	if(b == NULL || b->size - b->used < len){
+		size = (len > ARENA_BLOCK) ? len : ARENA_BLOCK;
+		b = malloc(sizeof(arena_block_t) + size);
+		if(b == NULL){
+			return NULL;
+		}
+		b->used = 0;
+		b->size = size;
+		b->next = p->blocks;
+		p->blocks = b;
+		p->arena_bytes += sizeof(arena_block_t) + size;
+	}
+	b->used += len;
+	return b->data + b->used - len;
+}
+
+int intern_init(intern_pool_t *p){
+	memset(p, 0, sizeof(*p));
+	p->index_cap = 1024;
+	p->index = calloc(p->index_cap, sizeof(*p->index));
+	return (p->index == NULL) ? -1 : 0;
+}
+
+void intern_free(intern_pool_t *p){
+	arena_block_t *b, *next;
+
+	for(b=p->blocks; b!=NULL; b=next){
+		next = b->next;
+		free(b);
+	}
+	free(p->entries);
+	free(p->index);
+	memset(p, 0, sizeof(*p));
+}
+
+// Double the index, placing IDs by their stored hash
+static int intern_grow(intern_pool_t *p){
+	unsigned int cap = p->index_cap * 2, mask = cap - 1, i, pos;
+	unsigned int *index = calloc(cap, sizeof(*index));
+
+	if(index == NULL){
+		return -1;
+	}
+	for(i=0; i<p->count; i++){
+		for(pos=p->entries[i].hash & mask; index[pos]; pos=(pos + 1) & mask);
+		index[pos] = i + 1;
+	}
+	free(p->index);
+	p->index = index;
+	p->index_cap = cap;
+	return 0;
+}
+
+// ID of the string of len bytes at s, adding it if it is new.
+// Returns INTERN_NONE if out of memory.
+unsigned int intern(intern_pool_t *p, const char *s, size_t len){
+	unsigned int h = (unsigned int)djb2_len((const unsigned char *)s, len);
+	unsigned int mask = p->index_cap - 1, pos, id;
+	intern_entry_t *e;
+	char *copy;
+
+	for(pos=h & mask; p->index[pos]; pos=(pos + 1) & mask){
+		e = &p->entries[p->index[pos] - 1];
+		if(e->hash == h && e->len == len && memcmp(e->str, s, len) == 0){
+			return p->index[pos] - 1;
+		}
+	}
+
+	//keep the index at most half full. Grow before anything is added, so a
+	//failure leaves the pool as it was; the new slot moves with the index.
+	if((p->count + 1) * 2 > p->index_cap){
+		if(intern_grow(p) != 0){
+			return INTERN_NONE;
+		}
+		mask = p->index_cap - 1;
+		for(pos=h & mask; p->index[pos]; pos=(pos + 1) & mask);
+	}
+	if(p->count == p->entries_cap){
+		unsigned int cap = p->entries_cap ? p->entries_cap * 2 : 1024;
+		e = realloc(p->entries, cap * sizeof(*e));
+		if(e == NULL){
+			return INTERN_NONE;
+		}
+		p->entries = e;
+		p->entries_cap = cap;
+	}
+	copy = arena_alloc(p, len + 1);
+	if(copy == NULL){
+		return INTERN_NONE;
+	}
+	memcpy(copy, s, len);
+	copy[len] = 0;
+
+	id = p->count++;
+	p->entries[id].str = copy;
+	p->entries[id].len = (unsigned int)len;
+	p->entries[id].hash = h;
+	p->index[pos] = id + 1;
+	return id;
+}
+
+unsigned int intern_cstr(intern_pool_t *p, const char *s){
+	return intern(p, s, strlen(s));
+}
+
+// The stored string of an ID, NUL-terminated and stable for the pool's life
+const char *intern_str(const intern_pool_t *p, unsigned int id){
+	return (id < p->count) ? p->entries[id].str : NULL;
+}
+
+unsigned int intern_len(const intern_pool_t *p, unsigned int id){
+	return (id < p->count) ? p->entries[id].len : 0;
+}
+
+// Memory held by the pool against one strdup per string, for calls strings
+// of call_bytes bytes in all, NULs included. malloc adds about 16 bytes of
+// header and rounds to 16, which strdup pays per copy.
+void intern_report(const intern_pool_t *p, size_t calls, size_t call_bytes){
+	size_t pool = p->arena_bytes + p->entries_cap * sizeof(intern_entry_t)
+		+ p->index_cap * sizeof(unsigned int);
+	size_t naive = call_bytes + calls * (sizeof(char *) + 16);
+
+	printf("%lu strings interned, %u distinct\n", (unsigned long)calls, p->count);
+	printf("pool   %10lu bytes (arena %lu, entries %lu, index %lu)\n", (unsigned long)pool,
+		(unsigned long)p->arena_bytes, (unsigned long)(p->entries_cap * sizeof(intern_entry_t)),
+		(unsigned long)(p->index_cap * sizeof(unsigned int)));
+	printf("strdup %10lu bytes (estimated)\n", (unsigned long)naive);
+	if(naive > pool){
+		printf("saved  %10lu bytes (%.1f%%)\n", (unsigned long)(naive - pool), 100.0 * (naive - pool) / naive);
+	}
+}
+
+int main(int argc, char **argv){
+	size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 2000000;
+	unsigned int vocab = (argc > 2) ? (unsigned int)strtoul(argv[2], NULL, 10) : 50000;
+	unsigned int *ids = malloc(n * sizeof(*ids));
+	char **dups = malloc(n * sizeof(*dups));
+	char buf[64];
+	intern_pool_t pool;
+	size_t i, bad = 0, calls = 0, call_bytes = 0;
+	clock_t start;
+	double ti, td;
+	unsigned int w;
+
+	if(ids == NULL || dups == NULL || intern_init(&pool) != 0){
+		return 1;
+	}
+
+	//skewed stream: low word numbers repeat far more often than high ones
+	srand(5);
+	start = clock();
+	for(i=0; i<n; i++){
+		w = (unsigned int)((double)rand() / RAND_MAX * (double)rand() / RAND_MAX * vocab);
+		call_bytes += sprintf(buf, "token_%u_of_the_stream", w) + 1;
+		calls++;
+		ids[i] = intern_cstr(&pool, buf);
+	}
+	ti = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	srand(5);
+	start = clock();
+	for(i=0; i<n; i++){
+		w = (unsigned int)((double)rand() / RAND_MAX * (double)rand() / RAND_MAX * vocab);
+		sprintf(buf, "token_%u_of_the_stream", w);
+		dups[i] = malloc(strlen(buf) + 1);
+		strcpy(dups[i], buf);
+	}
+	td = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	//same text gives the same ID and the ID gives back the text
+	for(i=0; i<n; i++){
+		if(strcmp(intern_str(&pool, ids[i]), dups[i]) != 0 || intern_cstr(&pool, dups[i]) != ids[i]){
+			bad++;
+		}
+	}
+	for(i=0; i<n; i++){
+		free(dups[i]);
+	}
+
+	intern_report(&pool, calls, call_bytes);
+	printf("intern %.2f Mstrings/s, strdup %.2f Mstrings/s, %lu mismatches\n",
+		n / ti / 1e6, n / td / 1e6, (unsigned long)bad);
+
+	intern_free(&pool);
+	free(ids);
+	free(dups);
+	return 0;
+}
@@ -0,0 +1,513 @@
+// wordFrequencyImplementation
+// Parallel word counting for large text files, built on djb2 (or sdbm
+// with -DWORD_SDBM).
+//  - The input is mmap'd and split into one segment per thread. Each split
+//    point is moved forward to the end of the word it lands in, so no word
+//    is cut in two.
+//  - Each thread counts its own segment into tables that only it touches,
+//    so there are no locks and no shared cache lines while counting. Words
+//    are not copied: table entries point into the mapped file.
+//  - Each thread's table is split into NPART partitions by the top bits of
+//    the hash. All threads use the same split, so a word can only be in
+//    partition p of any thread. Partition p of every thread is merged by a
+//    single worker, and the workers never need to talk to each other.
+//  - The worker that merges a partition also picks its top K with a small
+//    heap. The final top K is picked from NPART * K candidates.
+// A word is a run of letters, digits, apostrophes and bytes >= 0x80, so
+// UTF-8 text stays whole. Case is kept.
+// main() times the whole pipeline at 1, 2, 4, ... threads and prints the
+// speedup over one thread. The counts must match at every thread count.
+// Usage: wordFrequencyImplementation [file] [max threads] [k]
+// To run: gcc -O2 -pthread wordFrequencyImplementation.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define NPART 64		// merge partitions, from the top 6 bits of the hash
+#define PART_SHIFT 58
+#define MAX_THREADS 64
+
+#ifdef WORD_SDBM
+#define HASH_SEED 0UL
+#define HASH_STEP(h, c) ((c) + ((h) << 6) + ((h) << 16) - (h))	// sdbmHashImplementation.c
+#else
+#define HASH_SEED 5381UL
+#define HASH_STEP(h, c) (((h) << 5) + (h) + (c))			// djb2HashImplementation.c
+#endif
+
+typedef struct word_entry{
+	const unsigned char *word;	// into the input, not NUL-terminated
+	unsigned long long hash;
+	unsigned int len;
+	unsigned long count;
+} word_entry_t;
+
+typedef struct word_table{
+	word_entry_t *slots;
+	size_t cap, count;		// cap is a power of two
+} word_table_t;
+
+static unsigned char is_word[256];
+
+static void init_word_bytes(void){
+	int c;
+
+	for(c=0; c<256; c++){
+		is_word[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+			|| c == '\'' || c >= 0x80;
+	}
+}
+
+// djb2 and sdbm keep their low bits close to the last bytes, so mix before
+// using the hash for the slot and the partition
+static unsigned long long mix64(unsigned long long x){
+	x ^= x >> 33;
+	x *= 0xFF51AFD7ED558CCDULL;
+	x ^= x >> 33;
+	x *= 0xC4CEB9FE1A85EC53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static int table_init(word_table_t *t, size_t cap){
+	t->cap = cap;
+	t->count = 0;
+	t->slots = calloc(cap, sizeof(*t->slots));
+	return (t->slots == NULL) ? -1 : 0;
+}
+
+static void table_free(word_table_t *t){
+	free(t->slots);
+	t->slots = NULL;
+	t->cap = t->count = 0;
+}
+
+static word_entry_t *table_slot(word_table_t *t, const unsigned char *w, unsigned int len, unsigned long long h){
+	size_t mask = t->cap - 1, pos;
+	word_entry_t *e;
+
+	for(pos=h & mask; ; pos=(pos + 1) & mask){
+		e = &t->slots[pos];
+		if(e->word == NULL || (e->hash == h && e->len == len && memcmp(e->word, w, len) == 0)){
+			return e;
+		}
+	}
+}
+
+static int table_grow(word_table_t *t){
+	word_table_t bigger;
+	size_t i;
+
+	if(table_init(&bigger, t->cap * 2) != 0){
+		return -1;
+	}
+	for(i=0; i<t->cap; i++){
+		if(t->slots[i].word != NULL){
+			*table_slot(&bigger, t->slots[i].word, t->slots[i].len, t->slots[i].hash) = t->slots[i];
+		}
+	}
+	bigger.count = t->count;
+	free(t->slots);
+	*t = bigger;
+	return 0;
+}
+
+// Add count to a word, inserting it if it is new
+static int table_add(word_table_t *t, const unsigned char *w, unsigned int len, unsigned long long h, unsigned long count){
+	word_entry_t *e = table_slot(t, w, len, h);
+
+	if(e->word != NULL){
+		e->count += count;
+		return 0;
+	}
+	e->word = w;
+	e->len = len;
+	e->hash = h;
+	e->count = count;
+	//keep each table at most half full
+	if(++t->count * 2 > t->cap){
+		return table_grow(t);
+	}
+	return 0;
+}
+
+//counting
+typedef struct count_job{
+	const unsigned char *data;
+	size_t start, end;
+	word_table_t part[NPART];
+	size_t tokens;
+	int failed;
+} count_job_t;
+
+static void *count_segment(void *arg){
+	count_job_t *j = arg;
+	const unsigned char *d = j->data;
+	size_t p = j->start, s;
+	unsigned long h;
+	unsigned long long m;
+	int i;
+
+	for(i=0; i<NPART; i++){
+		if(table_init(&j->part[i], 1024) != 0){
+			j->failed = 1;
+			return NULL;
+		}
+	}
+	while(p < j->end){
+		for(; p<j->end && !is_word[d[p]]; p++);
+		if(p == j->end){
+			break;
+		}
+		h = HASH_SEED;
+		for(s=p; p<j->end && is_word[d[p]]; p++){
+			h = HASH_STEP(h, d[p]);
+		}
+		m = mix64(h);
+		if(table_add(&j->part[m >> PART_SHIFT], d + s, (unsigned int)(p - s), m, 1) != 0){
+			j->failed = 1;
+			return NULL;
+		}
+		j->tokens++;
+	}
+	return NULL;
+}
+
+//merging and top K
+typedef struct merge_pool{
+	count_job_t *job;
+	int nthreads;
+	size_t k;
+	word_entry_t **top;		// NPART rows of k candidates
+	size_t ntop[NPART];
+	atomic_int next;
+	atomic_int failed;
+} merge_pool_t;
+
+// More frequent first, then by bytes so the order is the same every run
+static int entry_before(const word_entry_t *a, const word_entry_t *b){
+	int c;
+
+	if(a->count != b->count){
+		return a->count > b->count;
+	}
+	c = memcmp(a->word, b->word, (a->len < b->len) ? a->len : b->len);
+	return (c != 0) ? c < 0 : a->len < b->len;
+}
+
+// Min-heap on entry_before: the root is the weakest of the best k so far
+static void heap_sift_down(word_entry_t **heap, size_t n, size_t i){
+	size_t c;
+	word_entry_t *tmp;
+
+	while((c = 2 * i + 1) < n){
+		if(c + 1 < n && entry_before(heap[c], heap[c + 1])){
+			c++;
+		}
+		if(!entry_before(heap[i], heap[c])){
+			return;
+		}
+		tmp = heap[i];
+		heap[i] = heap[c];
+		heap[c] = tmp;
+		i = c;
+	}
+}
+
+static size_t top_k(word_table_t *t, word_entry_t **heap, size_t k){
+	size_t n = 0, i, j;
+
+	for(i=0; i<t->cap; i++){
+		if(t->slots[i].word == NULL){
+			continue;
+		}
+		if(n < k){
+			heap[n++] = &t->slots[i];
+			if(n == k){
+				for(j=k/2; j-->0; ){
+					heap_sift_down(heap, k, j);
+				}
+			}
+		}else if(entry_before(&t->slots[i], heap[0])){
+			heap[0] = &t->slots[i];
+			heap_sift_down(heap, k, 0);
+		}
+	}
+	return n;
+}
+
+// Partition p of every thread goes into partition p of thread 0
+static void *merge_worker(void *arg){
+	merge_pool_t *pool = arg;
+	word_table_t *dst, *src;
+	size_t i;
+	int p, t;
+
+	while((p = atomic_fetch_add(&pool->next, 1)) < NPART){
+		dst = &pool->job[0].part[p];
+		for(t=1; t<pool->nthreads; t++){
+			src = &pool->job[t].part[p];
+			for(i=0; i<src->cap; i++){
+				if(src->slots[i].word != NULL && table_add(dst, src->slots[i].word, src->slots[i].len,
+						src->slots[i].hash, src->slots[i].count) != 0){
+					atomic_store(&pool->failed, 1);
+					return NULL;
+				}
+			}
+			table_free(src);
+		}
+		pool->ntop[p] = top_k(dst, pool->top + (size_t)p * pool->k, pool->k);
+	}
+	return NULL;
+}
+
+static int cmp_entry(const void *a, const void *b){
+	const word_entry_t *x = *(word_entry_t * const *)a, *y = *(word_entry_t * const *)b;
+	return entry_before(x, y) ? -1 : entry_before(y, x);
+}
+
+typedef struct word_counts{
+	count_job_t *job;		// job[0].part holds the merged counts
+	int nthreads;
+	size_t tokens, distinct;
+	word_entry_t **top;		// best first
+	size_t ntop;
+	double count_sec, merge_sec;
+} word_counts_t;
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void word_counts_free(word_counts_t *wc){
+	int t, p;
+
+	if(wc->job != NULL){
+		for(t=0; t<wc->nthreads; t++){
+			for(p=0; p<NPART; p++){
+				table_free(&wc->job[t].part[p]);
+			}
+		}
+	}
+	free(wc->job);
+	free(wc->top);
+	memset(wc, 0, sizeof(*wc));
+}
+
+// Count the words of data[0..n) with nthreads threads and keep the k most
+// frequent. The result points into data. Returns -1 if out of memory.
+int count_words(const unsigned char *data, size_t n, int nthreads, size_t k, word_counts_t *wc){
+	pthread_t th[MAX_THREADS];
+	merge_pool_t pool;
+	word_entry_t **cand;
+	size_t s, c;
+	double t0;
+	int t, p;
+
+	memset(wc, 0, sizeof(*wc));
+	if(nthreads < 1 || nthreads > MAX_THREADS || k == 0){
+		return -1;
+	}
+	wc->nthreads = nthreads;
+	wc->job = calloc(nthreads, sizeof(*wc->job));
+	wc->top = malloc(NPART * k * sizeof(*wc->top));
+	if(wc->job == NULL || wc->top == NULL){
+		word_counts_free(wc);
+		return -1;
+	}
+
+	t0 = now();
+	for(t=0; t<nthreads; t++){
+		s = n / nthreads * t;
+		if(t > 0){
+			//move the split to the end of the word it falls in
+			s = (s > wc->job[t - 1].start) ? s : wc->job[t - 1].start;
+			for(; s<n && s>0 && is_word[data[s - 1]] && is_word[data[s]]; s++);
+			wc->job[t - 1].end = s;
+		}
+		wc->job[t].data = data;
+		wc->job[t].start = s;
+	}
+	wc->job[nthreads - 1].end = n;
+	for(t=0; t<nthreads; t++){
+		pthread_create(&th[t], NULL, count_segment, &wc->job[t]);
+	}
+	for(t=0; t<nthreads; t++){
+		pthread_join(th[t], NULL);
+		wc->tokens += wc->job[t].tokens;
+	}
+	wc->count_sec = now() - t0;
+	for(t=0; t<nthreads; t++){
+		if(wc->job[t].failed){
+			word_counts_free(wc);
+			return -1;
+		}
+	}
+
+	t0 = now();
+	pool.job = wc->job;
+	pool.nthreads = nthreads;
+	pool.k = k;
+	pool.top = wc->top;
+	atomic_init(&pool.next, 0);
+	atomic_init(&pool.failed, 0);
+	for(t=0; t<nthreads; t++){
+		pthread_create(&th[t], NULL, merge_worker, &pool);
+	}
+	for(t=0; t<nthreads; t++){
+		pthread_join(th[t], NULL);
+	}
+	if(atomic_load(&pool.failed)){
+		word_counts_free(wc);
+		return -1;
+	}
+
+	//gather the per-partition candidates to the front and sort them
+	cand = wc->top;
+	for(p=0, c=0; p<NPART; p++){
+		memmove(cand + c, wc->top + (size_t)p * k, pool.ntop[p] * sizeof(*cand));
+		c += pool.ntop[p];
+		wc->distinct += wc->job[0].part[p].count;
+	}
+	qsort(cand, c, sizeof(*cand), cmp_entry);
+	wc->ntop = (c < k) ? c : k;
+	wc->merge_sec = now() - t0;
+	return 0;
+}
+
+// Text with a Zipf-like word distribution over `vocab` made-up words
+static unsigned char *synthetic_text(size_t n, size_t vocab){
+	static const char *syl[] = {"ka", "to", "ri", "men", "sa", "lo", "ne", "vi", "dar", "po",
+		"qu", "el", "an", "si", "mo", "ter", "ba", "fi", "ul", "go"};
+	unsigned char *d = malloc(n + 64);
+	double *cdf = malloc(vocab * sizeof(*cdf));
+	char (*words)[40] = malloc(vocab * sizeof(*words));
+	unsigned long long x = 88172645463325252ULL;
+	size_t i, w, lo, hi, mid, p = 0, len;
+	double total = 0, u;
+
+	if(d == NULL || cdf == NULL || words == NULL){
+		free(d);
+		free(cdf);
+		free(words);
+		return NULL;
+	}
+	for(i=0; i<vocab; i++){
+		words[i][0] = 0;
+		for(w=i; ; w/=20){
+			strcat(words[i], syl[w % 20]);
+			if(w < 20){
+				break;
+			}
+		}
+		total += 1.0 / (i + 1);
+		cdf[i] = total;
+	}
+	while(p < n){
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		u = (double)(x >> 11) / 9007199254740992.0 * total;
+		for(lo=0, hi=vocab-1; lo<hi; ){
+			mid = (lo + hi) / 2;
+			if(cdf[mid] < u){
+				lo = mid + 1;
+			}else{
+				hi = mid;
+			}
+		}
+		len = strlen(words[lo]);
+		memcpy(d + p, words[lo], len);
+		p += len;
+		d[p++] = ((x >> 3) % 12 == 0) ? '\n' : ' ';
+	}
+	free(cdf);
+	free(words);
+	return d;
+}
+
+int main(int argc, char **argv){
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	int maxthreads = (argc > 2) ? atoi(argv[2]) : (int)((cores < 4) ? 4 : cores);
+	size_t k = (argc > 3) ? strtoul(argv[3], NULL, 10) : 10;
+	const unsigned char *data;
+	unsigned char *owned = NULL;
+	word_counts_t wc;
+	size_t n, tokens = 0, distinct = 0, i;
+	struct stat st;
+	double t, base = 0, sec;
+	int fd = -1, nthreads, ok = 1;
+
+	if(maxthreads < 1 || maxthreads > MAX_THREADS || k == 0){
+		return 1;
+	}
+	init_word_bytes();
+	if(argc > 1){
+		fd = open(argv[1], O_RDONLY);
+		if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0){
+			printf("Could not read %s\n", argv[1]);
+			return 1;
+		}
+		n = (size_t)st.st_size;
+		data = mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data == MAP_FAILED){
+			printf("Could not map %s\n", argv[1]);
+			return 1;
+		}
+	}else{
+		n = 256u << 20;
+		owned = synthetic_text(n, 500000);
+		if(owned == NULL){
+			return 1;
+		}
+		data = owned;
+	}
+
+	printf("%.1f MB, %ld cores\n", n / 1e6, cores);
+	printf("threads   count s   merge s   total s   MB/s    speedup\n");
+	for(nthreads=1; nthreads<=maxthreads; nthreads*=2){
+		t = now();
+		if(count_words(data, n, nthreads, k, &wc) != 0){
+			printf("Out of memory\n");
+			return 1;
+		}
+		sec = now() - t;
+		if(nthreads == 1){
+			base = sec;
+			tokens = wc.tokens;
+			distinct = wc.distinct;
+		}else if(wc.tokens != tokens || wc.distinct != distinct){
+			ok = 0;
+		}
+		printf("%7d %9.3f %9.3f %9.3f %8.0f %8.2fx\n", nthreads, wc.count_sec, wc.merge_sec, sec,
+			n / sec / 1e6, base / sec);
+		if(nthreads * 2 > maxthreads){
+			break;
+		}
+		word_counts_free(&wc);
+	}
+
+	printf("%lu words, %lu distinct%s\n", (unsigned long)wc.tokens, (unsigned long)wc.distinct,
+		ok ? "" : ", COUNTS DIFFER BETWEEN THREAD COUNTS");
+	for(i=0; i<wc.ntop; i++){
+		printf("%10lu  %.*s\n", wc.top[i]->count, (int)wc.top[i]->len, (const char *)wc.top[i]->word);
+	}
+
+	word_counts_free(&wc);
+	if(fd >= 0){
+		munmap((void *)data, n);
+		close(fd);
+	}
+	free(owned);
+	return 0;
+}
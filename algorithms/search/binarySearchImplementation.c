@@ -1,33 +1,338 @@
 // binarySearchImplementation
+// Binary search over a sorted int array, from the textbook recursive form
+// to versions that stay fast when the array is far bigger than the cache.
+//  - binarySearchImplementation: recursive, returns the index of x or -1.
+//  - lower_bound_branchy: iterative lower bound with an if per step. The
+//    branch goes either way with equal odds, so it mispredicts about half
+//    the time.
+//  - lower_bound_branchless: the step is a conditional move, so there is
+//    nothing to mispredict. The loop runs exactly log2(n) times and the
+//    prefetch variant loads both possible next midpoints a step early.
+//  - Eytzinger layout: the array in BFS order of the implicit binary
+//    search tree, node k at b[k] with children 2k and 2k+1. The top levels
+//    share a few cache lines, and the 16 descendants four levels down are
+//    one cache line, so it can be prefetched before it is needed.
+//  - lower_bound_batch: many keys at once. The branchless search takes the
+//    same number of steps for every key, so a group of up to 64 searches
+//    can advance in lockstep. Each step prefetches every search's next
+//    probe, and those misses overlap instead of waiting one at a time.
+// Sizes are size_t throughout; only the recursive version takes int bounds.
+// main() measures lookups per second from L1-sized arrays up to 1 GB, then
+// batch sizes 1 to 64 against one search at a time.
+// Usage: binarySearchImplementation [max log2 n]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+
+#define MAX_BATCH 64
 
 int binarySearchImplementation(int arr[], int l, int r, int x){
-	
-	if(r >= 1){
-		int mid = l + (r - 1)/2;
-		
+
+	if(r >= l){
+		int mid = l + (r - l)/2;
+
 		if(arr[mid] == x){
 			return mid;
 		}
-		
+
 		if(arr[mid] > x){
 			return binarySearchImplementation(arr, l, mid-1, x);
 		}
-		
+
 		return binarySearchImplementation(arr, mid+1, r, x);
 	}
-	
+
 	return -1;
 }
 
-int main(void){
-	
-	int arr[] = {3,5,7,8,10};
-	
-	int n = sizeof(arr)/ sizeof(arr[0]);
-	int x = 10;
-	int result = binarySearchImplementation(arr, 0, n-1, x);
-	(result == -1)? printf("Number is not in array"): printf("Number is at index %d", result);
-	
+// Index of the first element >= x, or n if there is none
+size_t lower_bound_branchy(const int *arr, size_t n, int x){
+	size_t lo = 0, hi = n, mid;
+
+	while(lo < hi){
+		mid = lo + (hi - lo) / 2;
+		if(arr[mid] < x){
+			lo = mid + 1;
+		}else{
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+size_t lower_bound_branchless(const int *arr, size_t n, int x){
+	const int *base = arr;
+	size_t half;
+
+	if(n == 0){
+		return 0;
+	}
+	while(n > 1){
+		half = n / 2;
+		base = (base[half] < x) ? base + half : base;
+		n -= half;
+	}
+	return (size_t)(base - arr) + (*base < x);
+}
+
+size_t lower_bound_prefetch(const int *arr, size_t n, int x){
+	const int *base = arr;
+	size_t half;
+
+	if(n == 0){
+		return 0;
+	}
+	while(n > 1){
+		half = n / 2;
+		//the next midpoint is base[half / 2] or base[half + half / 2]
+		PREFETCH(base + half / 2);
+		PREFETCH(base + half + half / 2);
+		base = (base[half] < x) ? base + half : base;
+		n -= half;
+	}
+	return (size_t)(base - arr) + (*base < x);
+}
+
+// out[i] = lower bound of keys[i], searching batch keys at a time
+void lower_bound_batch(const int *arr, size_t n, const int *keys, size_t nkeys, size_t *out, size_t batch){
+	const int *base[MAX_BATCH];
+	size_t i, j, m, len, half;
+
+	if(batch < 1){
+		batch = 1;
+	}
+	if(batch > MAX_BATCH){
+		batch = MAX_BATCH;
+	}
+	for(i=0; i<nkeys; i+=batch){
+		m = (nkeys - i < batch) ? nkeys - i : batch;
+		for(j=0; j<m; j++){
+			base[j] = arr;
+		}
+		if(n == 0){
+			for(j=0; j<m; j++){
+				out[i + j] = 0;
+			}
+			continue;
+		}
+		for(len=n; len>1; len-=half){
+			half = len / 2;
+			for(j=0; j<m; j++){
+				base[j] = (base[j][half] < keys[i + j]) ? base[j] + half : base[j];
+				//where this search will probe on the next step
+				PREFETCH(base[j] + (len - half) / 2);
+			}
+		}
+		for(j=0; j<m; j++){
+			out[i + j] = (size_t)(base[j] - arr) + (*base[j] < keys[i + j]);
+		}
+	}
+}
+
+//Eytzinger layout
+static size_t eytzinger_fill(const int *arr, int *b, size_t n, size_t i, size_t k){
+	if(k <= n){
+		i = eytzinger_fill(arr, b, n, i, 2 * k);
+		b[k] = arr[i++];
+		i = eytzinger_fill(arr, b, n, i, 2 * k + 1);
+	}
+	return i;
+}
+
+// Copy of the sorted array arr in BFS order, with the root at b[1].
+// Aligned to 64 bytes so each group of 16 descendants is one cache
+// line. Free with free(). Returns NULL if out of memory.
+int *eytzinger_build(const int *arr, size_t n){
+	size_t bytes = ((n + 1) * sizeof(int) + 63) & ~(size_t)63;
+	int *b = aligned_alloc(64, bytes);
+
+	if(b == NULL){
+		return NULL;
+	}
+	b[0] = 0;
+	eytzinger_fill(arr, b, n, 0, 1);
+	return b;
+}
+
+// Trailing zero bits of x, which is not 0
+static int ctz64(unsigned long long x){
+#if defined(__GNUC__)
+	return __builtin_ctzll(x);
+#else
+	int n = 0;
+	for(; !(x & 1); x >>= 1){
+		n++;
+	}
+	return n;
+#endif
+}
+
+// Eytzinger index of the first element >= x, or 0 if there is none.
+// The descent goes right when b[k] < x; at the end, the last left turn is
+// the answer, found by dropping the trailing right turns (1 bits) and then
+// that left turn.
+size_t eytzinger_lower_bound(const int *b, size_t n, int x){
+	size_t k = 1;
+
+	while(k <= n){
+		PREFETCH(b + k * 16);
+		k = 2 * k + (b[k] < x);
+	}
+	k >>= ctz64(~(unsigned long long)k) + 1;
+	return k;
+}
+
+//benchmark
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Batch sizes 1 to 64 against one search at a time on an array of n
+static void bench_batch(size_t n, int *queries, size_t nq){
+	int *arr = malloc(n * sizeof(int));
+	size_t *out = malloc(nq * sizeof(*out)), *expect = malloc(nq * sizeof(*expect));
+	unsigned long long x = 0x9E3779B97F4A7C15ULL;
+	size_t i, q, batch;
+	double t;
+
+	if(arr == NULL || out == NULL || expect == NULL){
+		free(arr);
+		free(out);
+		free(expect);
+		return;
+	}
+	for(i=0; i<n; i++){
+		arr[i] = (int)(2 * i);
+	}
+	for(q=0; q<nq; q++){
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		queries[q] = (int)(x % (2 * n));
+	}
+	printf("%lu ints (%luK), Mlookups/s:", (unsigned long)n, (unsigned long)(n * sizeof(int) >> 10));
+	t = now();
+	for(q=0; q<nq; q++){
+		expect[q] = lower_bound_branchy(arr, n, queries[q]);
+	}
+	printf(" branchy %.2f,", nq / (now() - t) / 1e6);
+	t = now();
+	for(q=0; q<nq; q++){
+		out[q] = lower_bound_branchless(arr, n, queries[q]);
+	}
+	printf(" branchless %.2f\n", nq / (now() - t) / 1e6);
+	for(batch=1; batch<=MAX_BATCH; batch*=2){
+		memset(out, 0, nq * sizeof(*out));
+		t = now();
+		lower_bound_batch(arr, n, queries, nq, out, batch);
+		t = now() - t;
+		printf("  batch %2lu %8.2f%s\n", (unsigned long)batch, nq / t / 1e6,
+			memcmp(out, expect, nq * sizeof(*out)) ? "  MISMATCH" : "");
+	}
+	free(arr);
+	free(out);
+	free(expect);
+}
+
+int main(int argc, char **argv){
+	int max_log = (argc > 1) ? atoi(argv[1]) : 28;
+	size_t nq = 1000000, n, i, q, bad;
+	int arr_demo[] = {3,5,7,8,10};
+	int *arr, *b, *queries = malloc(nq * sizeof(int));
+	unsigned long long x = 88172645463325252ULL, sum, check, found;
+	double t[5];
+	int lg, result;
+
+	result = binarySearchImplementation(arr_demo, 0, 4, 10);
+	(result == -1)? printf("Number is not in array\n"): printf("Number is at index %d\n", result);
+
+	if(queries == NULL || max_log < 10 || max_log > 30){
+		return 1;
+	}
+	printf("Mlookups/s, %lu random lookups per size\n", (unsigned long)nq);
+	printf("%10s %10s %10s %10s %10s %10s %10s\n", "n", "bytes", "recursive", "branchy", "branchless", "prefetch", "eytzinger");
+	for(lg=10; lg<=max_log; lg+=2){
+		n = (size_t)1 << lg;
+		arr = malloc(n * sizeof(int));
+		if(arr == NULL){
+			break;
+		}
+		for(i=0; i<n; i++){
+			arr[i] = (int)(2 * i);
+		}
+		b = eytzinger_build(arr, n);
+		if(b == NULL){
+			free(arr);
+			break;
+		}
+		//half the queries are in the array, half fall between elements
+		for(q=0; q<nq; q++){
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+			queries[q] = (int)(x % (2 * n));
+		}
+
+		t[0] = now();
+		for(q=0, found=0; q<nq; q++){
+			found += (binarySearchImplementation(arr, 0, (int)(n - 1), queries[q]) >= 0);
+		}
+		t[0] = now() - t[0];
+
+		t[1] = now();
+		for(q=0, sum=0; q<nq; q++){
+			sum += lower_bound_branchy(arr, n, queries[q]);
+		}
+		t[1] = now() - t[1];
+		check = sum;
+
+		t[2] = now();
+		for(q=0, sum=0; q<nq; q++){
+			sum += lower_bound_branchless(arr, n, queries[q]);
+		}
+		t[2] = now() - t[2];
+		bad = (sum != check);
+
+		t[3] = now();
+		for(q=0, sum=0; q<nq; q++){
+			sum += lower_bound_prefetch(arr, n, queries[q]);
+		}
+		t[3] = now() - t[3];
+		bad += (sum != check);
+
+		//compare by value: arr[i] is 2 * i, and 2 * n stands for "none"
+		t[4] = now();
+		for(q=0, sum=0; q<nq; q++){
+			i = eytzinger_lower_bound(b, n, queries[q]);
+			sum += (i == 0) ? 2 * n : (unsigned long long)b[i];
+		}
+		t[4] = now() - t[4];
+		bad += (sum != 2 * check);
+		//only the even queries are in the array
+		for(q=0; q<nq; q++){
+			found -= (queries[q] % 2 == 0);
+		}
+		bad += (found != 0);
+
+		printf("%10lu %9luK %10.2f %10.2f %10.2f %10.2f %10.2f%s\n", (unsigned long)n,
+			(unsigned long)(n * sizeof(int) >> 10), nq / t[0] / 1e6, nq / t[1] / 1e6, nq / t[2] / 1e6,
+			nq / t[3] / 1e6, nq / t[4] / 1e6, bad ? "  MISMATCH" : "");
+		free(arr);
+		free(b);
+	}
+
+	bench_batch((size_t)1 << 16, queries, nq);
+	bench_batch((size_t)1 << (max_log < 26 ? max_log : 26), queries, nq);
+	free(queries);
 	return 0;
-	
-}
\ No newline at end of file
+}
@@ -0,0 +1,264 @@
+// exponentialSearchImplementation
+// Exponential (galloping) search finds a bound by doubling a step until it
+// passes the key, then binary searches inside the last step. A key at
+// index i costs about 2 log2(i) probes whatever n is, so it beats binary
+// search when answers sit near where the search starts, and it works when
+// n is not known at all.
+//  - exponential_lower_bound: gallops from the front of an array.
+//  - source_lower_bound: the same over a cursor that can only say whether
+//    element i exists and what it is, such as a stream of unknown length.
+//    Doubling stops at the first element >= x or the first missing one, and
+//    missing elements compare as +infinity in the binary search after.
+//  - finger_lower_bound: keeps the index of the last answer and gallops
+//    from there, forwards or backwards. A run of queries that move by d
+//    elements each costs O(log d) per query instead of O(log n).
+// main() compares them with branchless binary search on sorted,
+// locally correlated and random queries, and counts reads on a stream.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Branchless lower bound from binarySearchImplementation.c
+static size_t lower_bound_branchless(const int *arr, size_t n, int x){
+	const int *base = arr;
+	size_t half;
+
+	if(n == 0){
+		return 0;
+	}
+	while(n > 1){
+		half = n / 2;
+		base = (base[half] < x) ? base + half : base;
+		n -= half;
+	}
+	return (size_t)(base - arr) + (*base < x);
+}
+
+// Index of the first element >= x, or n if there is none
+size_t exponential_lower_bound(const int *arr, size_t n, int x){
+	size_t lo = 0, step = 1;
+
+	if(n == 0 || arr[0] >= x){
+		return 0;
+	}
+	//arr[lo] < x; the answer is in (lo, lo + step]
+	while(step < n - lo && arr[lo + step] < x){
+		lo += step;
+		step *= 2;
+	}
+	step = (step < n - lo) ? step : n - lo - 1;
+	return lo + 1 + lower_bound_branchless(arr + lo + 1, step, x);
+}
+
+// A sorted sequence read one element at a time. get() stores element i in
+// *out and returns 1, or returns 0 if the sequence has fewer than i + 1
+// elements. Elements past the end are never asked for twice.
+typedef struct sorted_source{
+	int (*get)(void *ctx, size_t i, int *out);
+	void *ctx;
+} sorted_source_t;
+
+// Index of the first element >= x, or the length of the sequence if there
+// is none. The length is never needed up front.
+size_t source_lower_bound(const sorted_source_t *src, int x){
+	size_t lo, hi, mid, step = 1;
+	int v;
+
+	if(!src->get(src->ctx, 0, &v) || v >= x){
+		return 0;
+	}
+	//element lo exists and is < x; hi is missing or >= x
+	lo = 0;
+	for(;;){
+		hi = lo + step;
+		if(!src->get(src->ctx, hi, &v) || v >= x){
+			break;
+		}
+		lo = hi;
+		step *= 2;
+	}
+	while(hi - lo > 1){
+		mid = lo + (hi - lo) / 2;
+		if(src->get(src->ctx, mid, &v) && v < x){
+			lo = mid;
+		}else{
+			hi = mid;
+		}
+	}
+	return hi;
+}
+
+// Where the last search ended, for queries that come in order or close
+// together
+typedef struct finger{
+	const int *arr;
+	size_t n;
+	size_t pos;	// last answer, in [0, n]
+} finger_t;
+
+void finger_init(finger_t *f, const int *arr, size_t n){
+	f->arr = arr;
+	f->n = n;
+	f->pos = 0;
+}
+
+// Index of the first element >= x, or n. Gallops from the last answer.
+size_t finger_lower_bound(finger_t *f, int x){
+	const int *arr = f->arr;
+	size_t pos = f->pos, lo, hi, step = 1;
+
+	if(pos < f->n && arr[pos] < x){
+		//forwards: arr[lo] < x, the answer is in (lo, lo + step]
+		lo = pos;
+		while(step < f->n - lo && arr[lo + step] < x){
+			lo += step;
+			step *= 2;
+		}
+		step = (step < f->n - lo) ? step : f->n - lo - 1;
+		pos = lo + 1 + lower_bound_branchless(arr + lo + 1, step, x);
+	}else{
+		//backwards: arr[hi] >= x (or hi == n), the answer is in [hi - step, hi]
+		hi = pos;
+		while(step <= hi && arr[hi - step] >= x){
+			hi -= step;
+			step *= 2;
+		}
+		lo = (step <= hi) ? hi - step + 1 : 0;
+		pos = lo + lower_bound_branchless(arr + lo, hi - lo, x);
+	}
+	f->pos = pos;
+	return pos;
+}
+
+//benchmark
+static unsigned long long rng = 88172645463325252ULL;
+
+static unsigned long long next_rand(void){
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// A stream of 3 * i for i < len that counts how often it is read. len is
+// only known to the stream.
+typedef struct stream{
+	size_t len;
+	size_t reads;
+} stream_t;
+
+static int stream_get(void *ctx, size_t i, int *out){
+	stream_t *s = ctx;
+
+	s->reads++;
+	if(i >= s->len){
+		return 0;
+	}
+	*out = (int)(3 * i);
+	return 1;
+}
+
+static int cmp_int(const void *a, const void *b){
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+// Time each search over the same queries; the finger persists across them
+static void bench(const char *name, const int *arr, size_t n, const int *q, size_t nq){
+	finger_t f;
+	size_t i, check, sum;
+	double t;
+
+	printf("%s, Mlookups/s\n", name);
+	t = now();
+	for(i=0, check=0; i<nq; i++){
+		check += lower_bound_branchless(arr, n, q[i]);
+	}
+	printf("  binary      %8.2f\n", nq / (now() - t) / 1e6);
+	t = now();
+	for(i=0, sum=0; i<nq; i++){
+		sum += exponential_lower_bound(arr, n, q[i]);
+	}
+	printf("  exponential %8.2f%s\n", nq / (now() - t) / 1e6, (sum != check) ? "  MISMATCH" : "");
+	finger_init(&f, arr, n);
+	t = now();
+	for(i=0, sum=0; i<nq; i++){
+		sum += finger_lower_bound(&f, q[i]);
+	}
+	printf("  finger      %8.2f%s\n", nq / (now() - t) / 1e6, (sum != check) ? "  MISMATCH" : "");
+}
+
+int main(int argc, char **argv){
+	size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : (size_t)1 << 24;
+	size_t nq = 1000000, i, bad, len;
+	int *arr = malloc(n * sizeof(int)), *q = malloc(nq * sizeof(int)), walk, bits;
+	long long pos;
+	stream_t s;
+	sorted_source_t src = {stream_get, &s};
+
+	if(arr == NULL || q == NULL || n < 2 || n > (size_t)1 << 29){
+		return 1;
+	}
+	for(i=0; i<n; i++){
+		arr[i] = (int)(2 * i);
+	}
+	printf("%lu sorted ints, %lu queries\n", (unsigned long)n, (unsigned long)nq);
+
+	//sorted: a merge or join stepping through a second sorted list
+	for(i=0; i<nq; i++){
+		q[i] = (int)(next_rand() % (2 * n + 2));
+	}
+	qsort(q, nq, sizeof(int), cmp_int);
+	bench("sorted queries", arr, n, q, nq);
+
+	//random walk: each query within +-64 elements of the last, reflected
+	//at 0 and 2n. 4n does not fit in an int, so the walk is a long long.
+	pos = (long long)n;
+	for(i=0; i<nq; i++){
+		pos += (long long)(next_rand() % 257) - 128;
+		pos = (pos < 0) ? -pos : (pos > 2 * (long long)n) ? 4 * (long long)n - pos : pos;
+		q[i] = (int)pos;
+	}
+	bench("random walk, steps up to 64 elements", arr, n, q, nq);
+
+	//answers in the first 1000 elements
+	for(i=0; i<nq; i++){
+		q[i] = (int)(next_rand() % 2000);
+	}
+	bench("near the start", arr, n, q, nq);
+
+	//uncorrelated: the finger gallops across the whole array every time
+	for(i=0; i<nq; i++){
+		q[i] = (int)(next_rand() % (2 * n + 2));
+	}
+	bench("random queries", arr, n, q, nq);
+
+	//reads on a stream of unknown length, averaged over 1000 queries each
+	printf("stream of unknown length, reads per lookup\n");
+	for(len=1000; len<=100000000; len*=100){
+		s.len = len;
+		s.reads = 0;
+		bad = 0;
+		for(i=0; i<1000; i++){
+			walk = (int)(next_rand() % (3 * len + 3));
+			bad += (source_lower_bound(&src, walk) != (((size_t)walk + 2) / 3 < len ? ((size_t)walk + 2) / 3 : len));
+		}
+		printf("  %10lu  answer anywhere: %6.1f%s", (unsigned long)len, s.reads / 1000.0, bad ? "  MISMATCH" : "");
+		s.reads = 0;
+		for(i=0; i<1000; i++){
+			source_lower_bound(&src, (int)(next_rand() % 300));
+		}
+		for(bits=0; len >> bits; bits++);
+		printf("   answer <= 100: %5.1f   log2 %d\n", s.reads / 1000.0, bits);
+	}
+	free(arr);
+	free(q);
+	return 0;
+}
@@ -1,42 +1,259 @@
-#include<stdio.h>
+// interpolationSearchImplementation
+// Interpolation search guesses where x is from the values at the ends of
+// the range, instead of always taking the middle. On evenly spread keys it
+// needs O(log log n) probes, but on skewed keys each guess can land next
+// to the old end and it falls to O(n).
+// interpolation_lower_bound is the hardened version for 64-bit keys:
+//  - The guess is integer arithmetic only, with a 128-bit product so
+//    keys anywhere in the int64 range cannot overflow.
+//  - The two ends of the range are always values already read, so each
+//    guess costs one probe.
+//  - Interpolation-binary: a guess that does not at least halve the range
+//    is a bad guess. After MAX_BAD_GUESSES of them the rest of the range
+//    goes to binary search, so no input takes more than a few probes
+//    over log2(n), while evenly spread keys need O(log log n).
+//  - Interpolation-sequential: ranges of SEQ_THRESHOLD keys or fewer are
+//    finished with a linear scan, where guessing costs more than it saves.
+// Both need sorted input.
+// main() compares it with binary search and plain interpolation on
+// uniform, Zipf, clustered and exponential keys. Build with -DCOUNT_PROBES
+// to also report array reads per lookup.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#define SEQ_THRESHOLD 16
+#define MAX_BAD_GUESSES 2
 
 int interpolationSearchImplementation(int arr[], int n, int x){
-	
-	int lo = o, hi = (n - 1);
-	
-	
+
+	int lo = 0, hi = (n - 1);
+
+
 	while(lo <= hi && x >= arr[lo] && x <= arr[hi]){
-		
+
+		if(arr[hi] == arr[lo]){
+			return (arr[lo] == x) ? lo : -1;
+		}
+
 		int pos = lo + (((double)(hi - lo) / (arr[hi]-arr[lo]))*(x - arr[lo]));
-		
+
 		if(arr[pos] == x){
 			return pos;
 		}
-		
+
 		if(arr[pos] < x){
 			lo = pos + 1;
 		}else{
 			hi = pos - 1;
 		}
 	}
-	
+
 	return -1;
 }
 
-int main(){
-	
-	int arr[] = {4,5,2,9,2,45,29,22,33};
-	
-	int n = sizeof(arr)/sizeof(arr[0]);
-	
-	int x = 45;
-	int index = interpolationSearchImplementation(arr, n, x);
-	
+// Array reads are only counted in a build with -DCOUNT_PROBES, so the
+// searches stay reentrant and the timed runs are not instrumented
+#ifdef COUNT_PROBES
+static size_t probes;
+#define PROBE(k) (probes += (k))
+#else
+#define PROBE(k)
+#endif
+
+// Branchless lower bound from binarySearchImplementation.c, for int64_t
+static size_t binary_lower_bound(const int64_t *arr, size_t n, int64_t x){
+	const int64_t *base = arr;
+	size_t half;
+
+	if(n == 0){
+		return 0;
+	}
+	while(n > 1){
+		half = n / 2;
+		base = (base[half] < x) ? base + half : base;
+		n -= half;
+		PROBE(1);
+	}
+	PROBE(1);
+	return (size_t)(base - arr) + (*base < x);
+}
+
+// Index of the first element >= x, or n if there is none
+size_t interpolation_lower_bound(const int64_t *arr, size_t n, int64_t x){
+	size_t lo, hi, pos, width;
+	uint64_t lv, hv;
+	int bad = 0;
+
+	if(n == 0){
+		return 0;
+	}
+	PROBE(2);
+	if(arr[0] >= x){
+		return 0;
+	}
+	if(arr[n - 1] < x){
+		return n;
+	}
+	//arr[lo] < x <= arr[hi], and both values are known, so every step
+	//costs one probe
+	lo = 0;
+	hi = n - 1;
+	lv = (uint64_t)arr[lo];
+	hv = (uint64_t)arr[hi];
+	while(hi - lo > SEQ_THRESHOLD){
+		if(bad == MAX_BAD_GUESSES){
+			return lo + 1 + binary_lower_bound(arr + lo + 1, hi - lo - 1, x);
+		}
+		//offsets from arr[lo] as unsigned, so the difference cannot overflow
+		pos = lo + (size_t)((unsigned __int128)((uint64_t)x - lv) * (hi - lo) / (hv - lv));
+		pos = (pos <= lo) ? lo + 1 : (pos >= hi) ? hi - 1 : pos;
+		width = hi - lo;
+		PROBE(1);
+		if(arr[pos] < x){
+			lo = pos;
+			lv = (uint64_t)arr[pos];
+		}else{
+			hi = pos;
+			hv = (uint64_t)arr[pos];
+		}
+		bad += (hi - lo > width / 2);
+	}
+	for(lo++; lo<hi && arr[lo]<x; lo++){
+		PROBE(1);
+	}
+	return lo;
+}
+
+// Index of x, or -1
+long interpolation_search64(const int64_t *arr, size_t n, int64_t x){
+	size_t i = interpolation_lower_bound(arr, n, x);
+	return (i < n && arr[i] == x) ? (long)i : -1;
+}
+
+// Plain interpolation with the same integer guess, no fallback
+static size_t interpolation_plain(const int64_t *arr, size_t n, int64_t x){
+	size_t lo = 0, hi = n, pos;
+
+	while(lo < hi){
+		PROBE(2);
+		if(x <= arr[lo]){
+			return lo;
+		}
+		if(x > arr[hi - 1]){
+			return hi;
+		}
+		pos = lo + (size_t)((unsigned __int128)((uint64_t)x - (uint64_t)arr[lo]) * (hi - 1 - lo)
+			/ ((uint64_t)arr[hi - 1] - (uint64_t)arr[lo]));
+		PROBE(1);
+		if(arr[pos] < x){
+			lo = pos + 1;
+		}else{
+			hi = pos;
+		}
+	}
+	return lo;
+}
+
+//benchmark
+static uint64_t rng = 88172645463325252ULL;
+
+static uint64_t next_rand(void){
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+static double next_unit(void){
+	return ((next_rand() >> 11) + 0.5) / 9007199254740992.0;
+}
+
+// Sorted keys of one of four shapes
+static void make_keys(int64_t *a, size_t n, int shape){
+	size_t i;
+
+	for(i=0; i<n; i++){
+		switch(shape){
+		case 0:	//uniform: evenly spaced with jitter
+			a[i] = (int64_t)(i * 1000 + next_rand() % 1000);
+			break;
+		case 1:	//Zipf-like: gaps from a power law, a few of them huge
+			a[i] = (i ? a[i - 1] : 0) + 1 + (int64_t)fmin(pow(next_unit(), -1.5), 1e9);
+			break;
+		case 2:	//clustered: runs of 1000 close keys far apart
+			a[i] = (int64_t)((i / 1000) * (1ULL << 40) + (i % 1000) * 3 + next_rand() % 3);
+			break;
+		default:	//exponential: key grows as e^(40 i / n)
+			a[i] = (int64_t)exp(40.0 * i / n) + (int64_t)i;
+			break;
+		}
+	}
+}
+
+typedef size_t (*lower_bound_fn)(const int64_t *arr, size_t n, int64_t x);
+
+static void bench(const char *name, lower_bound_fn fn, const int64_t *a, size_t n, const int64_t *q, size_t nq,
+		const size_t *expect){
+	struct timespec t0, t1;
+	size_t i, bad = 0;
+	double sec;
+
+#ifdef COUNT_PROBES
+	probes = 0;
+#endif
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(i=0; i<nq; i++){
+		bad += (fn(a, n, q[i]) != expect[i]);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+#ifdef COUNT_PROBES
+	printf("  %-14s %9.1f ns %9.1f probes%s\n", name, sec / nq * 1e9, (double)probes / nq, bad ? "  WRONG" : "");
+#else
+	printf("  %-14s %9.1f ns%s\n", name, sec / nq * 1e9, bad ? "  WRONG" : "");
+#endif
+}
+
+int main(int argc, char **argv){
+	size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : (size_t)1 << 22;
+	size_t nq = 500000, nplain = 200, i, r;
+	static const char *shapes[] = {"uniform", "zipf", "clustered", "exponential"};
+	int64_t *a = malloc(n * sizeof(*a)), *q = malloc(nq * sizeof(*q));
+	size_t *expect = malloc(nq * sizeof(*expect));
+	int arr[] = {2,2,4,5,9,22,29,33,45};
+	int x = 45, index, s;
+
+	index = interpolationSearchImplementation(arr, sizeof(arr)/sizeof(arr[0]), x);
 	if(index != -1){
-		printf("Index found %d", index);
+		printf("Index found %d\n", index);
 	}else{
-		printf("Index not found.");
+		printf("Index not found.\n");
+	}
+
+	if(a == NULL || q == NULL || expect == NULL || n < 2){
+		return 1;
 	}
-	
+	printf("%lu int64 keys, %lu lookups (plain interpolation: %lu)\n", (unsigned long)n,
+		(unsigned long)nq, (unsigned long)nplain);
+	for(s=0; s<4; s++){
+		make_keys(a, n, s);
+		//half present, half one above a present key
+		for(i=0; i<nq; i++){
+			r = next_rand() % n;
+			q[i] = a[r] + (int64_t)(i & 1);
+			expect[i] = binary_lower_bound(a, n, q[i]);
+		}
+		printf("%s\n", shapes[s]);
+		bench("binary", binary_lower_bound, a, n, q, nq, expect);
+		bench("hybrid", interpolation_lower_bound, a, n, q, nq, expect);
+		bench("plain interp", interpolation_plain, a, n, q, nplain, expect);
+	}
+	free(a);
+	free(q);
+	free(expect);
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,353 @@
+// learnedIndexImplementation
+// A learned index replaces the search over a sorted array with a model of
+// where each key sits. Interpolation search assumes one straight line from
+// the first key to the last; this fits many short lines instead.
+//  - Build: one pass over the keys with a shrinking cone. A segment starts
+//    at a key and keeps the range of slopes that put every later key within
+//    eps positions of where it really is; when a key leaves the cone, a new
+//    segment starts there. Fewer segments on smooth keys, more on rough.
+//  - Each segment is its first key (8 bytes), a float slope and a 32-bit
+//    start position (8 bytes), 16 bytes in all. The first keys sit in their
+//    own array, so finding the segment is a branchless search over a small
+//    dense array.
+//  - Lookup: predict a position, clamp it to the segment, then a branchless
+//    lower bound inside a window of 2 * err + 2 keys. err is the largest
+//    error measured at build time with the stored float slopes, so rounding
+//    cannot push a key out of its window.
+// Keys must be sorted. Duplicates are fine: a run of equal keys adds a
+// second point to fit, key + 1 at the index past the run, so keys just
+// above the run are predicted as well as the run itself.
+// main() compares lookups per second and extra memory with binary search
+// and interpolation search on five key shapes, for several eps.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+typedef struct learned_seg{
+	float slope;		// positions per key unit
+	uint32_t pos;		// index of the segment's first key
+} learned_seg_t;
+
+typedef struct learned_index{
+	const int64_t *keys;	// the sorted array, not owned
+	size_t n;
+	int64_t *seg_keys;	// first key of each segment
+	learned_seg_t *segs;
+	size_t nsegs;
+	size_t err;		// largest prediction error over all keys
+} learned_index_t;
+
+// Branchless lower bound from binarySearchImplementation.c, for int64_t
+static size_t binary_lower_bound(const int64_t *arr, size_t n, int64_t x){
+	const int64_t *base = arr;
+	size_t half;
+
+	if(n == 0){
+		return 0;
+	}
+	while(n > 1){
+		half = n / 2;
+		base = (base[half] < x) ? base + half : base;
+		n -= half;
+	}
+	return (size_t)(base - arr) + (*base < x);
+}
+
+// Index of the last segment whose first key is <= x, or 0
+static size_t learned_segment(const learned_index_t *li, int64_t x){
+	size_t s = binary_lower_bound(li->seg_keys, li->nsegs, x);
+
+	//lower bound finds the first key >= x; step back unless it is x
+	if(s == li->nsegs || li->seg_keys[s] != x){
+		s -= (s > 0);
+	}
+	return s;
+}
+
+// Predicted position of x, clamped to the segment it falls in
+static size_t learned_predict(const learned_index_t *li, size_t s, int64_t x){
+	size_t end = (s + 1 < li->nsegs) ? li->segs[s + 1].pos : li->n;
+	double p;
+
+	if(x <= li->seg_keys[s]){
+		return li->segs[s].pos;
+	}
+	p = li->segs[s].pos + (double)li->segs[s].slope * (double)((uint64_t)x - (uint64_t)li->seg_keys[s]);
+	return (p >= (double)end) ? end : (size_t)p;
+}
+
+void learned_free(learned_index_t *li){
+	free(li->seg_keys);
+	free(li->segs);
+	li->seg_keys = NULL;
+	li->segs = NULL;
+	li->nsegs = 0;
+}
+
+// The points the model has to fit for the run of equal keys starting at
+// *i: the first copy at its index, and for a run of two or more also key + 1
+// at the index past the run, where the lower bound of anything just above
+// the run lands. Moves *i past the run and returns the number of points.
+static int learned_points(const int64_t *keys, size_t n, size_t *i, int64_t pk[2], size_t pp[2]){
+	size_t j;
+	int np = 1;
+
+	for(j=*i + 1; j<n && keys[j]==keys[*i]; j++);
+	pk[0] = keys[*i];
+	pp[0] = *i;
+	if(j - *i > 1 && keys[*i] != INT64_MAX && (j == n || keys[*i] + 1 < keys[j])){
+		pk[1] = keys[*i] + 1;
+		pp[1] = j;
+		np = 2;
+	}
+	*i = j;
+	return np;
+}
+
+// Append a segment from (key, pos) with a slope inside the cone
+static int learned_push(learned_index_t *li, size_t *cap, int64_t key, size_t pos, double lo_slope, double hi_slope){
+	void *p;
+
+	if(li->nsegs == *cap){
+		*cap *= 2;
+		p = realloc(li->seg_keys, *cap * sizeof(*li->seg_keys));
+		if(p == NULL){
+			return -1;
+		}
+		li->seg_keys = p;
+		p = realloc(li->segs, *cap * sizeof(*li->segs));
+		if(p == NULL){
+			return -1;
+		}
+		li->segs = p;
+	}
+	li->seg_keys[li->nsegs] = key;
+	li->segs[li->nsegs].pos = (uint32_t)pos;
+	//a segment of one point has no upper limit on its slope
+	li->segs[li->nsegs].slope = (float)(isinf(hi_slope) ? lo_slope : (lo_slope + hi_slope) / 2);
+	li->nsegs++;
+	return 0;
+}
+
+// Fit segments over keys[0..n) with at most eps error each.
+// Returns 0, or -1 if out of memory or n does not fit in 32 bits.
+int learned_build(learned_index_t *li, const int64_t *keys, size_t n, size_t eps){
+	size_t i, cap = 64, pred, e, pos0 = 0, pp[2];
+	int64_t key0 = 0, pk[2];
+	double lo_slope = 0, hi_slope = INFINITY, dx, dp;
+	int np, k, open = 0;
+
+	li->keys = keys;
+	li->n = n;
+	li->nsegs = 0;
+	li->err = 0;
+	li->seg_keys = malloc(cap * sizeof(*li->seg_keys));
+	li->segs = malloc(cap * sizeof(*li->segs));
+	if(li->seg_keys == NULL || li->segs == NULL || n > UINT32_MAX){
+		learned_free(li);
+		return -1;
+	}
+	for(i=0; i<n; ){
+		np = learned_points(keys, n, &i, pk, pp);
+		for(k=0; k<np; k++){
+			if(open){
+				dx = (double)((uint64_t)pk[k] - (uint64_t)key0);
+				dp = (double)(pp[k] - pos0);
+				if((dp + eps) / dx >= lo_slope && (dp - eps) / dx <= hi_slope){
+					lo_slope = fmax(lo_slope, (dp - eps) / dx);
+					hi_slope = fmin(hi_slope, (dp + eps) / dx);
+					continue;
+				}
+				//the point leaves the cone: close the segment, start one here
+				if(learned_push(li, &cap, key0, pos0, lo_slope, hi_slope) != 0){
+					learned_free(li);
+					return -1;
+				}
+			}
+			key0 = pk[k];
+			pos0 = pp[k];
+			lo_slope = 0;
+			hi_slope = INFINITY;
+			open = 1;
+		}
+	}
+	if(open && learned_push(li, &cap, key0, pos0, lo_slope, hi_slope) != 0){
+		learned_free(li);
+		return -1;
+	}
+	//measure the error the stored model really makes, at the same points
+	for(i=0; i<n; ){
+		np = learned_points(keys, n, &i, pk, pp);
+		for(k=0; k<np; k++){
+			pred = learned_predict(li, learned_segment(li, pk[k]), pk[k]);
+			e = (pred > pp[k]) ? pred - pp[k] : pp[k] - pred;
+			li->err = (e > li->err) ? e : li->err;
+		}
+	}
+	return 0;
+}
+
+// Index of the first key >= x, or n if there is none
+size_t learned_lower_bound(const learned_index_t *li, int64_t x){
+	size_t pred, lo, hi;
+
+	if(li->n == 0){
+		return 0;
+	}
+	pred = learned_predict(li, learned_segment(li, x), x);
+	//the answer is within err of the prediction, plus one for keys that
+	//fall between two stored keys
+	lo = (pred > li->err) ? pred - li->err : 0;
+	hi = pred + li->err + 1;
+	hi = (hi > li->n) ? li->n : hi;
+	return lo + binary_lower_bound(li->keys + lo, hi - lo, x);
+}
+
+// Model bytes, not counting the keys themselves
+size_t learned_bytes(const learned_index_t *li){
+	return li->nsegs * (sizeof(*li->seg_keys) + sizeof(*li->segs));
+}
+
+// Interpolation-binary search from interpolationSearchImplementation.c
+static size_t interpolation_lower_bound(const int64_t *arr, size_t n, int64_t x){
+	size_t lo, hi, pos, width;
+	uint64_t lv, hv;
+	int bad = 0;
+
+	if(n == 0 || arr[0] >= x){
+		return 0;
+	}
+	if(arr[n - 1] < x){
+		return n;
+	}
+	lo = 0;
+	hi = n - 1;
+	lv = (uint64_t)arr[lo];
+	hv = (uint64_t)arr[hi];
+	while(hi - lo > 16){
+		if(bad == 2){
+			return lo + 1 + binary_lower_bound(arr + lo + 1, hi - lo - 1, x);
+		}
+		pos = lo + (size_t)((unsigned __int128)((uint64_t)x - lv) * (hi - lo) / (hv - lv));
+		pos = (pos <= lo) ? lo + 1 : (pos >= hi) ? hi - 1 : pos;
+		width = hi - lo;
+		if(arr[pos] < x){
+			lo = pos;
+			lv = (uint64_t)arr[pos];
+		}else{
+			hi = pos;
+			hv = (uint64_t)arr[pos];
+		}
+		bad += (hi - lo > width / 2);
+	}
+	for(lo++; lo<hi && arr[lo]<x; lo++);
+	return lo;
+}
+
+//benchmark
+static uint64_t rng = 88172645463325252ULL;
+
+static uint64_t next_rand(void){
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+static double next_unit(void){
+	return ((next_rand() >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Sorted keys of one of five shapes: the four of
+// interpolationSearchImplementation.c and one with runs of duplicates
+static void make_keys(int64_t *a, size_t n, int shape){
+	size_t i;
+
+	for(i=0; i<n; i++){
+		switch(shape){
+		case 0:	//uniform: evenly spaced with jitter
+			a[i] = (int64_t)(i * 1000 + next_rand() % 1000);
+			break;
+		case 1:	//Zipf-like: gaps from a power law, a few of them huge
+			a[i] = (i ? a[i - 1] : 0) + 1 + (int64_t)fmin(pow(next_unit(), -1.5), 1e9);
+			break;
+		case 2:	//clustered: runs of 1000 close keys far apart
+			a[i] = (int64_t)((i / 1000) * (1ULL << 40) + (i % 1000) * 3 + next_rand() % 3);
+			break;
+		case 3:	//exponential: key grows as e^(40 i / n)
+			a[i] = (int64_t)exp(40.0 * i / n) + (int64_t)i;
+			break;
+		default:	//duplicates: runs of 16 copies on average, random gaps
+			a[i] = (i && next_rand() % 16) ? a[i - 1] : (i ? a[i - 1] : 0) + 1 + (int64_t)(next_rand() % 20000);
+			break;
+		}
+	}
+}
+
+int main(int argc, char **argv){
+	size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : (size_t)1 << 22;
+	size_t nq = 1000000, i, r, check, sum;
+	static const char *shapes[] = {"uniform", "zipf", "clustered", "exponential", "duplicates"};
+	static const size_t eps_list[] = {16, 64, 256};
+	int64_t *a = malloc(n * sizeof(*a)), *q = malloc(nq * sizeof(*q));
+	learned_index_t li;
+	double t, build;
+	int s, e;
+
+	if(a == NULL || q == NULL || n < 2){
+		return 1;
+	}
+	printf("%lu int64 keys (%luK), %lu lookups, Mlookups/s and extra bytes\n", (unsigned long)n,
+		(unsigned long)(n * sizeof(*a) >> 10), (unsigned long)nq);
+	for(s=0; s<5; s++){
+		make_keys(a, n, s);
+		//half present, half one above a present key
+		for(i=0; i<nq; i++){
+			r = next_rand() % n;
+			q[i] = a[r] + (int64_t)(i & 1);
+		}
+		printf("%s\n", shapes[s]);
+
+		t = now();
+		for(i=0, check=0; i<nq; i++){
+			check += binary_lower_bound(a, n, q[i]);
+		}
+		printf("  %-18s %8.2f %10s\n", "binary", nq / (now() - t) / 1e6, "0");
+
+		t = now();
+		for(i=0, sum=0; i<nq; i++){
+			sum += interpolation_lower_bound(a, n, q[i]);
+		}
+		printf("  %-18s %8.2f %10s%s\n", "interpolation", nq / (now() - t) / 1e6, "0",
+			(sum != check) ? "  MISMATCH" : "");
+
+		for(e=0; e<3; e++){
+			t = now();
+			if(learned_build(&li, a, n, eps_list[e]) != 0){
+				return 1;
+			}
+			build = now() - t;
+			t = now();
+			for(i=0, sum=0; i<nq; i++){
+				sum += learned_lower_bound(&li, q[i]);
+			}
+			t = now() - t;
+			printf("  learned eps %-6lu %8.2f %10lu  (%lu segments, err %lu, build %.0f ms)%s\n",
+				(unsigned long)eps_list[e], nq / t / 1e6, (unsigned long)learned_bytes(&li), (unsigned long)li.nsegs,
+				(unsigned long)li.err, build * 1e3, (sum != check) ? "  MISMATCH" : "");
+			learned_free(&li);
+		}
+	}
+	free(a);
+	free(q);
+	return 0;
+}
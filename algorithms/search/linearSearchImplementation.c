@@ -1,5 +1,27 @@
 // linearSearchImplementation
 // Time complexity: O(n)
+// linearSearchImplementation compares one int per iteration. The
+// linear_search_* functions compare 32 ints per step with AVX2 or 16 with
+// SSE2, then finish the tail one at a time; without either they are plain
+// loops. Each step ORs four vector compares together and only works out
+// which lane matched once any did, so the loop is one test and branch per
+// step. Three modes:
+//  - linear_search_first: index of the first match, or -1
+//  - linear_search_count: number of matches, with no branch in the loop
+//  - linear_search_all: indices of every match
+// linear_lower_bound is the sorted-array counterpart: it counts the
+// elements below x with no branch at all. Binary search always wins on
+// large arrays; main() finds where the crossover is.
+// To run: gcc -O2 -mavx2 linearSearchImplementation.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 int linearSearchImplementation(int arr[], int n, int x){
 	int i;
@@ -9,4 +31,289 @@ int linearSearchImplementation(int arr[], int n, int x){
 		}
 	}
 	return -1;
-}
\ No newline at end of file
+}
+
+#ifdef __AVX2__
+#define STEP 32
+
+// Bit j set if arr[j] == x, for j < 32
+static unsigned int match_mask(const int *arr, __m256i key){
+	unsigned int m0 = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)arr), key)));
+	unsigned int m1 = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(arr + 8)), key)));
+	unsigned int m2 = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(arr + 16)), key)));
+	unsigned int m3 = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(arr + 24)), key)));
+	return m0 | (m1 << 8) | (m2 << 16) | (m3 << 24);
+}
+
+static int any_match(const int *arr, __m256i key){
+	__m256i c0 = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)arr), key);
+	__m256i c1 = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(arr + 8)), key);
+	__m256i c2 = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(arr + 16)), key);
+	__m256i c3 = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(arr + 24)), key);
+	__m256i any = _mm256_or_si256(_mm256_or_si256(c0, c1), _mm256_or_si256(c2, c3));
+	return !_mm256_testz_si256(any, any);
+}
+
+#define KEY_T __m256i
+#define SET_KEY(x) _mm256_set1_epi32(x)
+
+#elif defined(__SSE2__)
+#define STEP 16
+
+static unsigned int match_mask(const int *arr, __m128i key){
+	unsigned int m0 = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)arr), key)));
+	unsigned int m1 = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(arr + 4)), key)));
+	unsigned int m2 = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(arr + 8)), key)));
+	unsigned int m3 = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(arr + 12)), key)));
+	return m0 | (m1 << 4) | (m2 << 8) | (m3 << 12);
+}
+
+static int any_match(const int *arr, __m128i key){
+	__m128i c0 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)arr), key);
+	__m128i c1 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(arr + 4)), key);
+	__m128i c2 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(arr + 8)), key);
+	__m128i c3 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(arr + 12)), key);
+	return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(c0, c1), _mm_or_si128(c2, c3))) != 0;
+}
+
+#define KEY_T __m128i
+#define SET_KEY(x) _mm_set1_epi32(x)
+#endif
+
+static int lowest_bit(unsigned int mask){
+	int i = 0;
+	while(!(mask & 1)){
+		mask >>= 1;
+		i++;
+	}
+	return i;
+}
+
+// Index of the first element equal to x, or -1
+long linear_search_first(const int *arr, size_t n, int x){
+	size_t i = 0;
+#ifdef STEP
+	KEY_T key = SET_KEY(x);
+
+	for(; i + STEP <= n; i+=STEP){
+		if(any_match(arr + i, key)){
+			return (long)(i + lowest_bit(match_mask(arr + i, key)));
+		}
+	}
+#endif
+#ifdef __AVX2__
+	//one vector at a time for what is left
+	for(; i + 8 <= n; i+=8){
+		unsigned int m = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(
+			_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(arr + i)), key)));
+		if(m){
+			return (long)(i + lowest_bit(m));
+		}
+	}
+#endif
+	for(; i<n; i++){
+		if(arr[i] == x){
+			return (long)i;
+		}
+	}
+	return -1;
+}
+
+// Lower bound of x in a sorted array, by counting the elements below it.
+// There is no early exit at all, so nothing to mispredict, which keeps it
+// level with binary search on small arrays.
+size_t linear_lower_bound(const int *arr, size_t n, int x){
+	size_t i = 0, count = 0;
+#ifdef __AVX2__
+	__m256i key = _mm256_set1_epi32(x), acc = _mm256_setzero_si256();
+	int lanes[8], j;
+
+	for(; i + 8 <= n; i+=8){
+		acc = _mm256_sub_epi32(acc, _mm256_cmpgt_epi32(key, _mm256_loadu_si256((const __m256i *)(arr + i))));
+	}
+	_mm256_storeu_si256((__m256i *)lanes, acc);
+	for(j=0; j<8; j++){
+		count += (unsigned int)lanes[j];
+	}
+#elif defined(__SSE2__)
+	__m128i key = _mm_set1_epi32(x), acc = _mm_setzero_si128();
+	int lanes[4], j;
+
+	for(; i + 4 <= n; i+=4){
+		acc = _mm_sub_epi32(acc, _mm_cmpgt_epi32(key, _mm_loadu_si128((const __m128i *)(arr + i))));
+	}
+	_mm_storeu_si128((__m128i *)lanes, acc);
+	for(j=0; j<4; j++){
+		count += (unsigned int)lanes[j];
+	}
+#endif
+	for(; i<n; i++){
+		count += (arr[i] < x);
+	}
+	return count;
+}
+
+// Number of elements equal to x
+size_t linear_search_count(const int *arr, size_t n, int x){
+	size_t i = 0, count = 0;
+#ifdef __AVX2__
+	__m256i key = _mm256_set1_epi32(x), acc = _mm256_setzero_si256();
+	int lanes[8], j;
+
+	//a match compares to -1, so subtracting it counts up
+	for(; i + 8 <= n; i+=8){
+		acc = _mm256_sub_epi32(acc, _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(arr + i)), key));
+	}
+	_mm256_storeu_si256((__m256i *)lanes, acc);
+	for(j=0; j<8; j++){
+		count += (unsigned int)lanes[j];
+	}
+#elif defined(__SSE2__)
+	__m128i key = _mm_set1_epi32(x), acc = _mm_setzero_si128();
+	int lanes[4], j;
+
+	for(; i + 4 <= n; i+=4){
+		acc = _mm_sub_epi32(acc, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(arr + i)), key));
+	}
+	_mm_storeu_si128((__m128i *)lanes, acc);
+	for(j=0; j<4; j++){
+		count += (unsigned int)lanes[j];
+	}
+#endif
+	for(; i<n; i++){
+		count += (arr[i] == x);
+	}
+	return count;
+}
+
+// Stores the index of every element equal to x in out, which needs room
+// for as many as there can be. Returns how many were stored.
+size_t linear_search_all(const int *arr, size_t n, int x, size_t *out){
+	size_t i = 0, count = 0;
+#ifdef STEP
+	KEY_T key = SET_KEY(x);
+	unsigned int m;
+
+	for(; i + STEP <= n; i+=STEP){
+		if(any_match(arr + i, key)){
+			for(m=match_mask(arr + i, key); m; m&=m-1){
+				out[count++] = i + lowest_bit(m);
+			}
+		}
+	}
+#endif
+	for(; i<n; i++){
+		if(arr[i] == x){
+			out[count++] = i;
+		}
+	}
+	return count;
+}
+
+// Branchless lower bound from binarySearchImplementation.c
+static size_t lower_bound_branchless(const int *arr, size_t n, int x){
+	const int *base = arr;
+	size_t half;
+
+	if(n == 0){
+		return 0;
+	}
+	while(n > 1){
+		half = n / 2;
+		base = (base[half] < x) ? base + half : base;
+		n -= half;
+	}
+	return (size_t)(base - arr) + (*base < x);
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//crossover benchmark: sorted arrays of n distinct ints, random present keys
+int main(void){
+	size_t n, nq, q, i, cross_first = 8, cross_lower = 8, *all;
+	int *arr = malloc(16384 * sizeof(int)), *queries = malloc(1000000 * sizeof(int));
+	unsigned long long x = 88172645463325252ULL;
+	long sum[4];
+	double t[4];
+	int bad = 0;
+
+	all = malloc(16384 * sizeof(*all));
+	if(arr == NULL || queries == NULL || all == NULL){
+		return 1;
+	}
+	for(i=0; i<16384; i++){
+		arr[i] = (int)(3 * i);
+	}
+	//modes on an array with repeats
+	arr[100] = arr[200] = arr[5000] = 42;
+	printf("42: first at %ld, %lu matches, all at", linear_search_first(arr, 16384, 42),
+		(unsigned long)linear_search_count(arr, 16384, 42));
+	for(q=0, n=linear_search_all(arr, 16384, 42, all); q<n; q++){
+		printf(" %lu", (unsigned long)all[q]);
+	}
+	printf("\n");
+	arr[100] = 300;
+	arr[200] = 600;
+	arr[5000] = 15000;
+
+#if defined(__AVX2__)
+	printf("AVX2, %d ints per step\n", STEP);
+#elif defined(__SSE2__)
+	printf("SSE2, %d ints per step\n", STEP);
+#else
+	printf("scalar\n");
+#endif
+	printf("ns per lookup\n%8s %10s %10s %10s %10s\n", "n", "scalar", "simd first", "simd lower", "binary");
+	for(n=8; n<=16384; n*=2){
+		nq = (n < 64) ? 1000000 : 64000000 / n;
+		for(q=0; q<nq; q++){
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+			queries[q] = arr[x % n];
+		}
+		t[0] = now();
+		for(q=0, sum[0]=0; q<nq; q++){
+			sum[0] += linearSearchImplementation(arr, (int)n, queries[q]);
+		}
+		t[0] = now() - t[0];
+		t[1] = now();
+		for(q=0, sum[1]=0; q<nq; q++){
+			sum[1] += linear_search_first(arr, n, queries[q]);
+		}
+		t[1] = now() - t[1];
+		t[2] = now();
+		for(q=0, sum[2]=0; q<nq; q++){
+			sum[2] += (long)linear_lower_bound(arr, n, queries[q]);
+		}
+		t[2] = now() - t[2];
+		t[3] = now();
+		for(q=0, sum[3]=0; q<nq; q++){
+			sum[3] += (long)lower_bound_branchless(arr, n, queries[q]);
+		}
+		t[3] = now() - t[3];
+		bad |= (sum[0] != sum[1] || sum[1] != sum[2] || sum[2] != sum[3]);
+		//the crossover is where binary search starts winning for good
+		if(t[1] <= t[3]){
+			cross_first = 2 * n;
+		}
+		if(t[2] <= t[3]){
+			cross_lower = 2 * n;
+		}
+		printf("%8lu %10.1f %10.1f %10.1f %10.1f\n", (unsigned long)n, t[0] / nq * 1e9, t[1] / nq * 1e9,
+			t[2] / nq * 1e9, t[3] / nq * 1e9);
+	}
+	printf("binary search beats simd first from n = %lu, simd lower bound from n = %lu\n",
+		(unsigned long)cross_first, (unsigned long)cross_lower);
+	if(bad){
+		printf("MISMATCH\n");
+	}
+	free(arr);
+	free(queries);
+	free(all);
+	return 0;
+}
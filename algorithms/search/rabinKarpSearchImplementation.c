@@ -0,0 +1,380 @@
+// rabinKarpSearchImplementation
+// Multi-pattern Rabin-Karp search over memory-mapped files.
+// djb2 and sdbm are both h = h*B + c (B = 33 and 65599), so the hash of a
+// window of m bytes can be rolled one byte at a time:
+//     R' = (R - c_out * B^(m-1)) * B + c_in
+// and seed * B^m + R is exactly djb2/sdbm of the window.
+// The engine rolls one djb2 window the size of the shortest pattern over
+// the text, so all patterns are found in a single pass. Patterns are
+// anchored on their last m bytes rather than their first: keywords in
+// logs tend to share prefixes ("user=", "/api/") and differ at the end.
+// A bitmap of pattern suffix hashes rejects almost every position with
+// one load, and the rest look up the suffix hash in a table and memcmp
+// the candidates.
+// Usage: rabinKarpSearchImplementation [file [patterns file]]
+// Without arguments a synthetic 256 MB log is written to a temporary file
+// in /tmp, mapped, and deleted again. main() compares against a strstr
+// loop per pattern.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FILTER_BITS 20
+
+typedef struct rolling_hash{
+	unsigned long base;
+	unsigned long seed_term;	// seed * base^m
+	unsigned long out_pow;		// base^(m-1)
+	unsigned long r;		// hash of the window without the seed
+	size_t m;
+} rolling_hash_t;
+
+// Start a rolling hash over the first m bytes of p
+void rolling_init(rolling_hash_t *rh, unsigned long base, unsigned long seed, const unsigned char *p, size_t m){
+	size_t i;
+
+	rh->base = base;
+	rh->m = m;
+	rh->r = 0;
+	rh->out_pow = 1;
+	rh->seed_term = seed;
+	for(i=0; i<m; i++){
+		rh->r = rh->r * base + p[i];
+		rh->seed_term *= base;
+		if(i > 0){
+			rh->out_pow *= base;
+		}
+	}
+}
+
+void rolling_roll(rolling_hash_t *rh, unsigned char out, unsigned char in){
+	rh->r = (rh->r - out * rh->out_pow) * rh->base + in;
+}
+
+// Same as rolling_roll for a djb2 window, with the base known to the
+// compiler so the multiply becomes a shift and add
+static void rolling_roll_djb2(rolling_hash_t *rh, unsigned char out, unsigned char in){
+	unsigned long r = rh->r - out * rh->out_pow;
+	rh->r = ((r << 5) + r) + in;
+}
+
+// djb2 or sdbm of the current window
+unsigned long rolling_value(const rolling_hash_t *rh){
+	return rh->seed_term + rh->r;
+}
+
+void rolling_djb2_init(rolling_hash_t *rh, const unsigned char *p, size_t m){
+	rolling_init(rh, 33, 5381, p, m);
+}
+
+void rolling_sdbm_init(rolling_hash_t *rh, const unsigned char *p, size_t m){
+	rolling_init(rh, 65599, 0, p, m);
+}
+
+// Length-aware djb2HashImplementation.c
+unsigned long djb2_len(const unsigned char *p, size_t len){
+	unsigned long hash = 5381;
+	while(len--){
+		hash = ((hash << 5) + hash) + *p++;
+	}
+	return hash;
+}
+
+//multi-pattern engine
+typedef struct rk_engine{
+	const char **pat;
+	size_t *len;
+	size_t npat;
+	size_t m;			// suffix length, the shortest pattern
+	unsigned long long *filter;	// 2^FILTER_BITS bits
+	unsigned long *slot_hash;	// suffix hash per table slot
+	size_t *slot_head;		// first pattern + 1 per slot, 0 is empty
+	size_t *next;			// next pattern with the same suffix hash, + 1
+	size_t cap;			// table slots, power of two
+} rk_engine_t;
+
+void rk_free(rk_engine_t *e){
+	free(e->len);
+	free(e->next);
+	free(e->filter);
+	free(e->slot_hash);
+	free(e->slot_head);
+	memset(e, 0, sizeof(*e));
+}
+
+static size_t filter_bit(unsigned long h){
+	return (size_t)(((unsigned long long)h * 0x9E3779B97F4A7C15ULL) >> (64 - FILTER_BITS));
+}
+
+// Index npat patterns for rk_search. Returns 0, or -1 with nothing left
+// allocated if a pattern is empty or memory runs out.
+int rk_build(rk_engine_t *e, const char **pat, size_t npat){
+	size_t i, pos;
+	unsigned long h;
+
+	memset(e, 0, sizeof(*e));
+	if(npat == 0){
+		return -1;
+	}
+	e->pat = pat;
+	e->npat = npat;
+	e->len = malloc(npat * sizeof(*e->len));
+	e->next = calloc(npat, sizeof(*e->next));
+	e->filter = calloc((size_t)1 << (FILTER_BITS - 6), sizeof(*e->filter));
+	for(e->cap=16; e->cap<npat*2; e->cap<<=1);
+	e->slot_hash = malloc(e->cap * sizeof(*e->slot_hash));
+	e->slot_head = calloc(e->cap, sizeof(*e->slot_head));
+	if(e->len == NULL || e->next == NULL || e->filter == NULL || e->slot_hash == NULL || e->slot_head == NULL){
+		rk_free(e);
+		return -1;
+	}
+
+	e->m = (size_t)-1;
+	for(i=0; i<npat; i++){
+		e->len[i] = strlen(pat[i]);
+		if(e->len[i] < e->m){
+			e->m = e->len[i];
+		}
+	}
+	if(e->m == 0){
+		rk_free(e);
+		return -1;
+	}
+	for(i=0; i<npat; i++){
+		h = djb2_len((const unsigned char *)pat[i] + e->len[i] - e->m, e->m);
+		e->filter[filter_bit(h) / 64] |= 1ULL << (filter_bit(h) % 64);
+		for(pos=h & (e->cap - 1); e->slot_head[pos] && e->slot_hash[pos] != h; pos=(pos + 1) & (e->cap - 1));
+		e->slot_hash[pos] = h;
+		e->next[i] = e->slot_head[pos];
+		e->slot_head[pos] = i + 1;
+	}
+	return 0;
+}
+
+// Count the occurrences of every pattern in text, overlapping ones
+// included, into counts[npat]. Returns the total number of matches.
+size_t rk_search(const rk_engine_t *e, const unsigned char *text, size_t n, size_t *counts){
+	rolling_hash_t rh;
+	size_t i, pos, p, len, total = 0;
+	unsigned long h;
+	size_t b;
+
+	if(n < e->m){
+		return 0;
+	}
+	//i is where the window starts, so a match of length len starts at
+	//i + m - len
+	rolling_djb2_init(&rh, text, e->m);
+	for(i=0; ; i++){
+		h = rolling_value(&rh);
+		b = filter_bit(h);
+		if(e->filter[b / 64] & (1ULL << (b % 64))){
+			for(pos=h & (e->cap - 1); e->slot_head[pos]; pos=(pos + 1) & (e->cap - 1)){
+				if(e->slot_hash[pos] != h){
+					continue;
+				}
+				for(p=e->slot_head[pos]; p; p=e->next[p - 1]){
+					len = e->len[p - 1];
+					if(i + e->m >= len && memcmp(text + i + e->m - len, e->pat[p - 1], len) == 0){
+						counts[p - 1]++;
+						total++;
+					}
+				}
+				break;
+			}
+		}
+		if(i + e->m >= n){
+			break;
+		}
+		rolling_roll_djb2(&rh, text[i], text[i + e->m]);
+	}
+	return total;
+}
+
+//input
+typedef struct mapped{
+	unsigned char *data;
+	size_t size;
+	int mapped;
+} mapped_t;
+
+// mmap the file, reading it into memory if it cannot be mapped
+static int map_file(mapped_t *f, const char *path){
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+
+	f->data = NULL;
+	f->mapped = 0;
+	if(fd < 0 || fstat(fd, &st) != 0){
+		if(fd >= 0){
+			close(fd);
+		}
+		return -1;
+	}
+	f->size = (size_t)st.st_size;
+	if(f->size > 0){
+		f->data = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(f->data != MAP_FAILED){
+			f->mapped = 1;
+			madvise(f->data, f->size, MADV_SEQUENTIAL);
+		}else{
+			f->data = malloc(f->size);
+			if(f->data == NULL || read(fd, f->data, f->size) != (ssize_t)f->size){
+				close(fd);
+				return -1;
+			}
+		}
+	}
+	close(fd);
+	return 0;
+}
+
+static void unmap_file(mapped_t *f){
+	if(f->mapped){
+		munmap(f->data, f->size);
+	}else{
+		free(f->data);
+	}
+}
+
+//benchmark helpers
+static const char *log_words[] = {
+	"GET", "POST", "/api/v1/users", "/api/v1/orders", "/static/app.js", "200", "404",
+	"500", "user=", "session=", "latency_ms=", "INFO", "WARN", "ERROR", "timeout",
+	"connection", "reset", "upstream", "cache", "miss", "hit", "retry", "payment"
+};
+
+static void write_synthetic_log(FILE *f, size_t bytes){
+	size_t written = 0;
+	char line[256];
+	int len, w;
+
+	srand(11);
+	while(written < bytes){
+		len = sprintf(line, "2024-01-%02d %s", 1 + rand() % 28, log_words[rand() % 14 + 9]);
+		for(w=0; w<6; w++){
+			len += sprintf(line + len, " %s%x", log_words[rand() % 23], rand() % 65536);
+		}
+		line[len++] = '\n';
+		fwrite(line, 1, len, f);
+		written += len;
+	}
+}
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv){
+	char tmp_path[] = "/tmp/rabinKarpSampleXXXXXX";
+	const char *path = (argc > 1) ? argv[1] : tmp_path;
+	size_t npat = 2000, naive_pats = 20, naive_bytes = 64u << 20;
+	char **pat = malloc(npat * sizeof(*pat));
+	size_t *counts = calloc(npat, sizeof(*counts));
+	size_t *check = calloc(npat, sizeof(*check));
+	size_t i, total, naive_n, c, bad = 0;
+	char *copy, *q, buf[256];
+	FILE *pf, *out;
+	mapped_t f;
+	int fd;
+	rk_engine_t e;
+	double t, trk, tnaive;
+
+	if(argc < 2){
+		fd = mkstemp(tmp_path);
+		out = (fd >= 0) ? fdopen(fd, "w") : NULL;
+		if(out == NULL){
+			printf("Could not create %s\n", tmp_path);
+			if(fd >= 0){
+				close(fd);
+				unlink(tmp_path);
+			}
+			return 1;
+		}
+		write_synthetic_log(out, 256u << 20);
+		fclose(out);
+	}
+	if(map_file(&f, path) != 0){
+		printf("Could not read %s\n", path);
+		if(argc < 2){
+			unlink(tmp_path);
+		}
+		return 1;
+	}
+	//the mapping keeps the data, so the temporary file can go now
+	if(argc < 2){
+		unlink(tmp_path);
+	}
+
+	//patterns from a file, one per line, or words that occur in the log
+	//and similar ones that mostly do not
+	pf = (argc > 2) ? fopen(argv[2], "r") : NULL;
+	for(i=0; pf!=NULL && i<npat && fgets(buf, sizeof(buf), pf)!=NULL; ){
+		buf[strcspn(buf, "\r\n")] = 0;
+		if(buf[0]){
+			pat[i] = malloc(strlen(buf) + 1);
+			strcpy(pat[i++], buf);
+		}
+	}
+	if(pf != NULL){
+		fclose(pf);
+		npat = i;
+		naive_pats = (npat < naive_pats) ? npat : naive_pats;
+	}
+	srand(3);
+	for(; i<npat; i++){
+		sprintf(buf, "%s%x", log_words[rand() % 23], rand() % 65536);
+		pat[i] = malloc(strlen(buf) + 1);
+		strcpy(pat[i], buf);
+	}
+
+	if(rk_build(&e, (const char **)pat, npat) != 0){
+		return 1;
+	}
+	t = now();
+	total = rk_search(&e, f.data, f.size, counts);
+	trk = now() - t;
+	printf("%.1f MB, %lu patterns (suffix %lu bytes): %lu matches in %.3f s, %.2f GB/s\n",
+		f.size / 1e6, (unsigned long)npat, (unsigned long)e.m, (unsigned long)total, trk, f.size / trk / 1e9);
+
+	//naive: one strstr loop per pattern over a NUL-terminated prefix
+	naive_n = (f.size < naive_bytes) ? f.size : naive_bytes;
+	copy = malloc(naive_n + 1);
+	memcpy(copy, f.data, naive_n);
+	copy[naive_n] = 0;
+	rk_search(&e, (const unsigned char *)copy, naive_n, check);
+	t = now();
+	for(i=0; i<naive_pats; i++){
+		for(c=0, q=copy; (q = strstr(q, pat[i])) != NULL; q++){
+			c++;
+		}
+		if(c != check[i]){
+			bad++;
+		}
+	}
+	tnaive = now() - t;
+	printf("strstr: %lu patterns over %.1f MB in %.3f s, %lu count mismatches\n",
+		(unsigned long)naive_pats, naive_n / 1e6, tnaive, (unsigned long)bad);
+	printf("strstr for all %lu patterns over the file would take about %.1f s, %.1fx the time\n",
+		(unsigned long)npat, tnaive * npat / naive_pats * f.size / naive_n,
+		tnaive * npat / naive_pats * f.size / naive_n / trk);
+
+	rk_free(&e);
+	unmap_file(&f);
+	for(i=0; i<npat; i++){
+		free(pat[i]);
+	}
+	free(pat);
+	free(counts);
+	free(check);
+	free(copy);
+	return 0;
+}
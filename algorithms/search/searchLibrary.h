@@ -0,0 +1,265 @@
+//////////////////////////////////////////////////////////////////////////////////
+// searchLibrary.h
+// Header-only templated versions of the searches in this directory, for any
+// random-access range: a pointer or iterator plus a size_t length, so arrays
+// over 2^31 elements work, and any element type with a comparator.
+//  - lower_bound, upper_bound: branchless, as lower_bound_branchless in
+//    binarySearchImplementation.c
+//  - linear_find, linear_lower_bound: as linearSearchImplementation.c, with
+//    the lower bound counting elements below the key with no branch
+//  - interpolation_lower_bound: as interpolationSearchImplementation.c, for
+//    arithmetic keys, with the same bad-guess fallback to binary search
+//  - exponential_lower_bound: doubles a step from the front until it
+//    passes the key, then a lower bound inside the last step; O(log i) for
+//    a key at index i
+//  - equal_range: lower_bound, then exponential search for the end
+// Every function returns an index in [0, n]; n means "none" or "past the
+// end", as std::lower_bound returns last. Comparators are strict weak
+// orders, as for std::sort, and are inlined like hand-written code.
+// C++11; see searchLibraryBenchmark.cpp for the comparison against the
+// hand-written int versions.
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace search
+{
+
+// Default comparator, a < b for any pair of types that support it
+struct Less
+{
+	template <class A, class B>
+	bool operator()(const A &a, const B &b) const
+	{
+		return a < b;
+	}
+};
+
+// Default key for interpolation: the element itself
+struct Identity
+{
+	template <class T>
+	const T &operator()(const T &v) const
+	{
+		return v;
+	}
+};
+
+// Compares key(element) with a plain value, for searches given a KeyOf
+template <class KeyOf>
+struct KeyLess
+{
+	KeyOf key;
+
+	explicit KeyLess(KeyOf k) : key(k)
+	{
+	}
+
+	template <class A, class B>
+	bool operator()(const A &a, const B &b) const
+	{
+		return key(a) < b;
+	}
+};
+
+// Index of the first element not less than key, or n
+template <class RandomIt, class Key, class Compare = Less>
+size_t lower_bound(RandomIt first, size_t n, const Key &key, Compare comp = Compare())
+{
+	RandomIt base = first;
+	size_t half;
+
+	if(n == 0){
+		return 0;
+	}
+	while(n > 1){
+		half = n / 2;
+		base = comp(base[half], key) ? base + half : base;
+		n -= half;
+	}
+	return (size_t)(base - first) + comp(*base, key);
+}
+
+// Index of the first element greater than key, or n
+template <class RandomIt, class Key, class Compare = Less>
+size_t upper_bound(RandomIt first, size_t n, const Key &key, Compare comp = Compare())
+{
+	RandomIt base = first;
+	size_t half;
+
+	if(n == 0){
+		return 0;
+	}
+	while(n > 1){
+		half = n / 2;
+		base = comp(key, base[half]) ? base : base + half;
+		n -= half;
+	}
+	return (size_t)(base - first) + !comp(key, *base);
+}
+
+// Index of the first element equal to key, or n. Any order.
+template <class RandomIt, class Key, class Compare = Less>
+size_t linear_find(RandomIt first, size_t n, const Key &key, Compare comp = Compare())
+{
+	size_t i;
+
+	for(i = 0; i < n; i++){
+		if(!comp(first[i], key) && !comp(key, first[i])){
+			break;
+		}
+	}
+	return i;
+}
+
+// Lower bound by counting, with no branch in the loop. Only wins on short
+// ranges; see linearSearchImplementation.c for where the crossover is.
+template <class RandomIt, class Key, class Compare = Less>
+size_t linear_lower_bound(RandomIt first, size_t n, const Key &key, Compare comp = Compare())
+{
+	size_t i, count = 0;
+
+	for(i = 0; i < n; i++){
+		count += comp(first[i], key);
+	}
+	return count;
+}
+
+// Where x falls between lv and hv, scaled to 0..width. Integers use an
+// unsigned difference, as interpolationSearchImplementation.c does, so
+// any signed range works. The product is 128-bit where the compiler has
+// it; elsewhere both values are shifted down until it fits in 64 bits,
+// which only makes the guess coarser.
+template <class V>
+size_t interpolation_offset(V x, V lv, V hv, size_t width, std::true_type)
+{
+	typedef typename std::make_unsigned<V>::type U;
+	uint64_t d = (uint64_t)((U)x - (U)lv), r = (uint64_t)((U)hv - (U)lv);
+
+	if(r == 0){
+		return width / 2;
+	}
+#if defined(__SIZEOF_INT128__)
+	return (size_t)((unsigned __int128)d * width / r);
+#else
+	while(r > UINT64_MAX / width){
+		d >>= 1;
+		r >>= 1;
+	}
+	return (size_t)(d * width / r);
+#endif
+}
+
+// Floating keys: a fraction of the range, with the middle for ranges that
+// are empty, infinite or NaN
+template <class V>
+size_t interpolation_offset(V x, V lv, V hv, size_t width, std::false_type)
+{
+	typedef typename std::common_type<V, double>::type F;
+	F f = ((F)x - (F)lv) / ((F)hv - (F)lv);
+
+	if(!(f >= 0 && f <= 1)){
+		return width / 2;
+	}
+	return (size_t)(f * (F)width);
+}
+
+// Lower bound for keys with arithmetic values, key(element) giving the
+// value. Guesses use integer arithmetic for integer keys and floating
+// point only for floating keys. After two guesses that fail to halve the
+// range the rest goes to binary search, so skewed keys cost a few probes
+// over log2(n).
+template <class RandomIt, class T, class KeyOf = Identity>
+size_t interpolation_lower_bound(RandomIt first, size_t n, const T &x, KeyOf key = KeyOf())
+{
+	typedef typename std::decay<decltype(key(*first))>::type Value;
+	typedef typename std::common_type<Value, T>::type V;
+	typename std::is_integral<V>::type integral;
+	size_t lo, hi, pos, width;
+	V lv, hv;
+	int bad = 0;
+
+	if(n == 0 || !(key(first[0]) < x)){
+		return 0;
+	}
+	if(key(first[n - 1]) < x){
+		return n;
+	}
+	// key(first[lo]) < x <= key(first[hi])
+	lo = 0;
+	hi = n - 1;
+	lv = (V)key(first[lo]);
+	hv = (V)key(first[hi]);
+	while(hi - lo > 16){
+		if(bad == 2){
+			return lo + 1 + lower_bound(first + lo + 1, hi - lo - 1, x, KeyLess<KeyOf>(key));
+		}
+		width = hi - lo;
+		pos = lo + interpolation_offset((V)x, lv, hv, width, integral);
+		pos = (pos <= lo) ? lo + 1 : (pos >= hi) ? hi - 1 : pos;
+		if(key(first[pos]) < x){
+			lo = pos;
+			lv = (V)key(first[pos]);
+		}else{
+			hi = pos;
+			hv = (V)key(first[pos]);
+		}
+		bad += (hi - lo > width / 2);
+	}
+	for(lo++; lo < hi && key(first[lo]) < x; lo++);
+	return lo;
+}
+
+// Lower bound that costs O(log i) for an answer at index i, so it beats
+// binary search when keys are near the front
+template <class RandomIt, class Key, class Compare = Less>
+size_t exponential_lower_bound(RandomIt first, size_t n, const Key &key, Compare comp = Compare())
+{
+	size_t lo = 0, step = 1;
+
+	// first[lo] < key on every pass; the answer is in (lo, lo + step]
+	if(n == 0 || !comp(first[0], key)){
+		return 0;
+	}
+	while(step < n - lo && comp(first[lo + step], key)){
+		lo += step;
+		step *= 2;
+	}
+	step = (step < n - lo) ? step : n - lo - 1;
+	return lo + 1 + lower_bound(first + lo + 1, step, key, comp);
+}
+
+// Turns a lower bound into an upper bound: "a is not greater than key"
+template <class Compare>
+struct NotGreater
+{
+	Compare comp;
+
+	explicit NotGreater(Compare c) : comp(c)
+	{
+	}
+
+	template <class A, class B>
+	bool operator()(const A &a, const B &b) const
+	{
+		return !comp(b, a);
+	}
+};
+
+// [lower_bound, upper_bound) of key. The end is found by galloping from
+// the start, so a short run of equal keys costs a few probes near the
+// start instead of a second full search.
+template <class RandomIt, class Key, class Compare = Less>
+std::pair<size_t, size_t> equal_range(RandomIt first, size_t n, const Key &key, Compare comp = Compare())
+{
+	size_t lo = lower_bound(first, n, key, comp);
+
+	return std::make_pair(lo, lo + exponential_lower_bound(first + lo, n - lo, key, NotGreater<Compare>(comp)));
+}
+
+} // namespace search
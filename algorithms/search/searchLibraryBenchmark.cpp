@@ -0,0 +1,246 @@
+//////////////////////////////////////////////////////////////////////////////////
+// searchLibraryBenchmark
+// Checks searchLibrary.h against std::lower_bound and times it against the
+// hand-written int searches it generalises: the recursive
+// binarySearchImplementation and lower_bound_branchless from
+// binarySearchImplementation.c. Then the same searches over uint64_t,
+// double and a struct key, through pointers and vector iterators.
+// To run: g++ -std=c++11 -O2 searchLibraryBenchmark.cpp
+//////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+#include <algorithm>
+#include <vector>
+#include "searchLibrary.h"
+
+// The hand-written versions, copied from binarySearchImplementation.c
+int binarySearchImplementation(int arr[], int l, int r, int x)
+{
+	if(r >= l){
+		int mid = l + (r - l)/2;
+
+		if(arr[mid] == x){
+			return mid;
+		}
+
+		if(arr[mid] > x){
+			return binarySearchImplementation(arr, l, mid-1, x);
+		}
+
+		return binarySearchImplementation(arr, mid+1, r, x);
+	}
+
+	return -1;
+}
+
+size_t lower_bound_branchless(const int *arr, size_t n, int x)
+{
+	const int *base = arr;
+	size_t half;
+
+	if(n == 0){
+		return 0;
+	}
+	while(n > 1){
+		half = n / 2;
+		base = (base[half] < x) ? base + half : base;
+		n -= half;
+	}
+	return (size_t)(base - arr) + (*base < x);
+}
+
+// A struct searched by one field
+struct Record
+{
+	uint64_t id;
+	double weight;
+};
+
+struct RecordLess
+{
+	bool operator()(const Record &a, uint64_t id) const
+	{
+		return a.id < id;
+	}
+	bool operator()(uint64_t id, const Record &a) const
+	{
+		return id < a.id;
+	}
+};
+
+struct RecordId
+{
+	uint64_t operator()(const Record &a) const
+	{
+		return a.id;
+	}
+};
+
+static uint64_t g_Rng = 88172645463325252ULL;
+
+static uint64_t NextRand()
+{
+	g_Rng ^= g_Rng << 13;
+	g_Rng ^= g_Rng >> 7;
+	g_Rng ^= g_Rng << 17;
+	return g_Rng;
+}
+
+static double Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int g_Mismatches = 0;
+
+// Times fn over every query, sums the results and checks them against the
+// sum std::lower_bound gave
+template <class Query, class Fn>
+static void Time(const char *name, const std::vector<Query> &queries, size_t expect, Fn fn)
+{
+	double t = Now();
+	size_t sum = 0;
+
+	for(size_t i = 0; i < queries.size(); i++){
+		sum += fn(queries[i]);
+	}
+	t = Now() - t;
+	if(sum != expect){
+		g_Mismatches++;
+	}
+	printf("  %-38s %8.2f%s\n", name, queries.size() / t / 1e6, sum != expect ? "  MISMATCH" : "");
+}
+
+// int: the library against the hand-written versions
+static void BenchInt(size_t n, size_t nq)
+{
+	std::vector<int> arr(n), queries(nq);
+	size_t expect = 0, found = 0;
+
+	for(size_t i = 0; i < n; i++){
+		arr[i] = (int)(2 * i);
+	}
+	for(size_t i = 0; i < nq; i++){
+		queries[i] = (int)(NextRand() % (2 * n));
+		expect += std::lower_bound(arr.begin(), arr.end(), queries[i]) - arr.begin();
+		found += (queries[i] % 2 == 0);
+	}
+	const int *a = arr.data();
+	printf("%lu ints (%luK), Mlookups/s\n", (unsigned long)n, (unsigned long)(n * sizeof(int) >> 10));
+	Time("recursive int (found count)", queries, found, [&](int x) {
+		return (size_t)(binarySearchImplementation((int *)a, 0, (int)(n - 1), x) >= 0);
+	});
+	Time("hand-written branchless int", queries, expect, [&](int x) {
+		return lower_bound_branchless(a, n, x);
+	});
+	Time("search::lower_bound<int *>", queries, expect, [&](int x) {
+		return search::lower_bound(a, n, x);
+	});
+	Time("search::lower_bound<vector iterator>", queries, expect, [&](int x) {
+		return search::lower_bound(arr.begin(), n, x);
+	});
+	Time("std::lower_bound", queries, expect, [&](int x) {
+		return (size_t)(std::lower_bound(arr.begin(), arr.end(), x) - arr.begin());
+	});
+}
+
+// Other key types, where the int versions cannot be used at all
+static void BenchTypes(size_t n, size_t nq)
+{
+	std::vector<uint64_t> u(n), uq(nq);
+	std::vector<double> d(n), dq(nq);
+	std::vector<Record> r(n);
+	size_t expect = 0, dexpect = 0, upper = 0, first = 0, near = 0;
+
+	for(size_t i = 0; i < n; i++){
+		u[i] = (uint64_t)i << 33 | (NextRand() & 0xFFFF);
+		d[i] = i * 0.5;
+		r[i].id = u[i];
+		r[i].weight = 1.0;
+	}
+	for(size_t i = 0; i < nq; i++){
+		uq[i] = u[NextRand() % n] + (i & 1);
+		dq[i] = (NextRand() % (2 * n)) * 0.25;
+		expect += std::lower_bound(u.begin(), u.end(), uq[i]) - u.begin();
+		upper += std::upper_bound(u.begin(), u.end(), uq[i]) - u.begin();
+		dexpect += std::lower_bound(d.begin(), d.end(), dq[i]) - d.begin();
+	}
+	printf("%lu keys of each type, Mlookups/s\n", (unsigned long)n);
+	Time("lower_bound uint64_t", uq, expect, [&](uint64_t x) {
+		return search::lower_bound(u.data(), n, x);
+	});
+	Time("upper_bound uint64_t", uq, upper, [&](uint64_t x) {
+		return search::upper_bound(u.data(), n, x);
+	});
+	Time("equal_range uint64_t (sum of ends)", uq, expect + upper, [&](uint64_t x) {
+		std::pair<size_t, size_t> e = search::equal_range(u.data(), n, x);
+		return e.first + e.second;
+	});
+	Time("interpolation uint64_t", uq, expect, [&](uint64_t x) {
+		return search::interpolation_lower_bound(u.data(), n, x);
+	});
+	Time("lower_bound double", dq, dexpect, [&](double x) {
+		return search::lower_bound(d.data(), n, x);
+	});
+	Time("interpolation double", dq, dexpect, [&](double x) {
+		return search::interpolation_lower_bound(d.data(), n, x);
+	});
+	Time("lower_bound Record by id", uq, expect, [&](uint64_t x) {
+		return search::lower_bound(r.begin(), n, x, RecordLess());
+	});
+	Time("interpolation Record by id", uq, expect, [&](uint64_t x) {
+		return search::interpolation_lower_bound(r.begin(), n, x, RecordId());
+	});
+
+	// keys in the first 1024 elements, where exponential search needs
+	// about 20 probes instead of log2(n)
+	for(size_t i = 0; i < nq; i++){
+		uq[i] = u[NextRand() % 1024] + (i & 1);
+		first += std::lower_bound(u.begin(), u.end(), uq[i]) - u.begin();
+	}
+	printf("same keys, answers in the first 1024, Mlookups/s\n");
+	Time("lower_bound uint64_t", uq, first, [&](uint64_t x) {
+		return search::lower_bound(u.data(), n, x);
+	});
+	Time("exponential uint64_t", uq, first, [&](uint64_t x) {
+		return search::exponential_lower_bound(u.data(), n, x);
+	});
+
+	// a short range: counting has no branch but reads every key
+	for(size_t i = 0; i < nq; i++){
+		uq[i] = u[NextRand() % 32] + (i & 1);
+		near += std::lower_bound(u.begin(), u.begin() + 32, uq[i]) - u.begin();
+	}
+	printf("32 keys, Mlookups/s\n");
+	Time("lower_bound uint64_t", uq, near, [&](uint64_t x) {
+		return search::lower_bound(u.data(), 32, x);
+	});
+	Time("linear_lower_bound uint64_t", uq, near, [&](uint64_t x) {
+		return search::linear_lower_bound(u.data(), 32, x);
+	});
+	Time("linear_find uint64_t (found count)", uq, nq / 2, [&](uint64_t x) {
+		return (size_t)(search::linear_find(u.data(), 32, x) < 32);
+	});
+}
+
+int main(int argc, char **argv)
+{
+	size_t nq = 1000000;
+	int maxLog = (argc > 1) ? atoi(argv[1]) : 24;
+
+	if(maxLog < 10 || maxLog > 30){
+		return 1;
+	}
+	for(int lg = 10; lg <= maxLog; lg += 7){
+		BenchInt((size_t)1 << lg, nq);
+	}
+	BenchTypes((size_t)1 << (maxLog < 22 ? maxLog : 22), nq);
+	printf("mismatches: %d\n", g_Mismatches);
+
+	return g_Mismatches != 0;
+}
@@ -0,0 +1,368 @@
+// staticBTreeImplementation
+// A static B+tree (S-tree) over a sorted int array, built once and then only
+// searched. Every node is one 64-byte cache line of 16 keys, so a lookup
+// touches one line per level: log17(n) lines, 8 for 10^9 keys, where binary
+// search and even the Eytzinger layout need about log2(n) = 30 probes with
+// only the last few sharing lines.
+//  - Layout: the bottom layer is the sorted keys themselves, padded to a
+//    multiple of 16 with INT_MAX. Each layer above holds, for each node, the
+//    smallest key of its children 1 to 16, so a node of 16 keys splits into
+//    17 children. Layers are stored bottom up, each one contiguous, and
+//    child i of node j is node j * 17 + i of the layer below, so there are
+//    no pointers.
+//  - Search: count the keys in the node below x with SIMD compares (AVX2:
+//    two 8-lane compares and a popcount; SSE2: four 4-lane ones), which is
+//    the child to go to. No branch depends on the data.
+//  - Build: the bottom layer is filled by the caller, or copied from an
+//    array; each key above is read straight from the bottom layer, so the
+//    index is one pass over n / 16 keys per layer.
+// Returns indices into the sorted array, so it is a drop-in for
+// lower_bound_branchless in binarySearchImplementation.c.
+// main() times the bulk build and lookups against binary search and the
+// Eytzinger layout, then builds a tree over 10^9 keys (about 4.3 GB).
+// Usage: staticBTreeImplementation [keys for the large build]
+// To run: gcc -O2 -mavx2 staticBTreeImplementation.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+
+#define STREE_B 16		// keys per node, one cache line of int
+#define STREE_MAX_HEIGHT 16	// 17^16 is far more than size_t can count
+
+typedef struct stree{
+	int *keys;		// all layers, 64-byte aligned
+	size_t n;		// keys in the bottom layer, without padding
+	int height;		// layers, 1 for a single bottom layer
+	size_t offset[STREE_MAX_HEIGHT + 1];	// start of each layer in keys, 0 is the bottom
+} stree_t;
+
+// Nodes needed for m keys
+static size_t stree_blocks(size_t m){
+	return (m + STREE_B - 1) / STREE_B;
+}
+
+// Keys in the layer above a layer of m keys: one node per 17 nodes below
+static size_t stree_parent_keys(size_t m){
+	return (stree_blocks(m) + STREE_B) / (STREE_B + 1) * STREE_B;
+}
+
+// Allocate a tree for n keys. Fill stree_leaves(t)[0..n) in sorted order,
+// then call stree_build_index. Returns 0, or -1 if out of memory.
+int stree_init(stree_t *t, size_t n){
+	size_t m = n, nodes;
+	int h = 0;
+
+	//layer sizes, bottom up, until one node holds a whole layer
+	t->offset[0] = 0;
+	for(;;){
+		nodes = stree_blocks(m) ? stree_blocks(m) : 1;
+		t->offset[h + 1] = t->offset[h] + nodes * STREE_B;
+		h++;
+		if(nodes == 1 || h == STREE_MAX_HEIGHT){
+			break;
+		}
+		m = stree_parent_keys(m);
+	}
+	t->height = h;
+	t->n = n;
+	t->keys = aligned_alloc(64, t->offset[h] * sizeof(int));
+	return (t->keys == NULL) ? -1 : 0;
+}
+
+int *stree_leaves(stree_t *t){
+	return t->keys;
+}
+
+void stree_free(stree_t *t){
+	free(t->keys);
+	t->keys = NULL;
+}
+
+// Build the layers above the bottom one
+void stree_build_index(stree_t *t){
+	size_t i, k;
+	int h, l;
+
+	for(i=t->n; i<t->offset[1]; i++){
+		t->keys[i] = INT_MAX;
+	}
+	for(h=1; h<t->height; h++){
+		for(i=0; i<t->offset[h + 1] - t->offset[h]; i++){
+			//key i of node k is the smallest key under child i + 1: go
+			//right once, then always left down to the bottom layer
+			k = (i / STREE_B) * (STREE_B + 1) + i % STREE_B + 1;
+			for(l=1; l<h; l++){
+				k *= STREE_B + 1;
+			}
+			t->keys[t->offset[h] + i] = (k * STREE_B < t->n) ? t->keys[k * STREE_B] : INT_MAX;
+		}
+	}
+}
+
+// Copy a sorted array into a new tree and build it. Returns 0 or -1.
+int stree_build(stree_t *t, const int *arr, size_t n){
+	if(stree_init(t, n) != 0){
+		return -1;
+	}
+	memcpy(t->keys, arr, n * sizeof(int));
+	stree_build_index(t);
+	return 0;
+}
+
+// Set bits of x
+static inline unsigned popcount32(unsigned x){
+#if defined(__GNUC__)
+	return (unsigned)__builtin_popcount(x);
+#else
+	unsigned n = 0;
+	for(; x; x &= x - 1){
+		n++;
+	}
+	return n;
+#endif
+}
+
+// Trailing zero bits of x, which is not 0
+static int ctz64(unsigned long long x){
+#if defined(__GNUC__)
+	return __builtin_ctzll(x);
+#else
+	int n = 0;
+	for(; !(x & 1); x >>= 1){
+		n++;
+	}
+	return n;
+#endif
+}
+
+// Number of the 16 keys at node that are less than x
+static inline unsigned stree_rank(const int *node, int x){
+#ifdef __AVX2__
+	__m256i xv = _mm256_set1_epi32(x);
+	__m256i lo = _mm256_cmpgt_epi32(xv, _mm256_load_si256((const __m256i *)node));
+	__m256i hi = _mm256_cmpgt_epi32(xv, _mm256_load_si256((const __m256i *)(node + 8)));
+	unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(lo))
+		| (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8;
+	return popcount32(mask);
+#elif defined(__SSE2__)
+	__m128i xv = _mm_set1_epi32(x);
+	unsigned mask = 0;
+	int j;
+	for(j=0; j<4; j++){
+		__m128i c = _mm_cmpgt_epi32(xv, _mm_load_si128((const __m128i *)(node + 4 * j)));
+		mask |= (unsigned)_mm_movemask_ps(_mm_castsi128_ps(c)) << (4 * j);
+	}
+	return popcount32(mask);
+#else
+	unsigned j, count = 0;
+	for(j=0; j<STREE_B; j++){
+		count += (node[j] < x);
+	}
+	return count;
+#endif
+}
+
+// Index of the first key >= x, or n if there is none
+size_t stree_lower_bound(const stree_t *t, int x){
+	size_t k = 0;	//start of the current node within its layer, in keys
+	int h;
+
+	for(h=t->height - 1; h>0; h--){
+		//child i of this node starts at (k / 16 * 17 + i) * 16
+		k = k * (STREE_B + 1) + stree_rank(t->keys + t->offset[h] + k, x) * STREE_B;
+	}
+	k += stree_rank(t->keys + k, x);
+	return (k < t->n) ? k : t->n;
+}
+
+// Total bytes, for comparison with the n * 4 of the plain array
+size_t stree_bytes(const stree_t *t){
+	return t->offset[t->height] * sizeof(int);
+}
+
+// Branchless lower bound from binarySearchImplementation.c
+static size_t lower_bound_branchless(const int *arr, size_t n, int x){
+	const int *base = arr;
+	size_t half;
+
+	if(n == 0){
+		return 0;
+	}
+	while(n > 1){
+		half = n / 2;
+		base = (base[half] < x) ? base + half : base;
+		n -= half;
+	}
+	return (size_t)(base - arr) + (*base < x);
+}
+
+// Eytzinger layout from binarySearchImplementation.c
+static size_t eytzinger_fill(const int *arr, int *b, size_t n, size_t i, size_t k){
+	if(k <= n){
+		i = eytzinger_fill(arr, b, n, i, 2 * k);
+		b[k] = arr[i++];
+		i = eytzinger_fill(arr, b, n, i, 2 * k + 1);
+	}
+	return i;
+}
+
+static size_t eytzinger_lower_bound(const int *b, size_t n, int x){
+	size_t k = 1;
+
+	while(k <= n){
+		PREFETCH(b + k * 16);
+		k = 2 * k + (b[k] < x);
+	}
+	k >>= ctz64(~(unsigned long long)k) + 1;
+	return k;
+}
+
+//benchmark
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long rng = 88172645463325252ULL;
+
+static unsigned long long next_rand(void){
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+// Lookups on the same keys with each layout. Keys are 2 * i, so half the
+// queries are present.
+static int bench_layouts(size_t n, size_t nq){
+	stree_t t;
+	int *arr, *b, *queries = malloc(nq * sizeof(int));
+	size_t i, q, sum, check, bad;
+	double t0, build;
+
+	if(queries == NULL || stree_init(&t, n) != 0){
+		free(queries);
+		return -1;
+	}
+	arr = stree_leaves(&t);
+	for(i=0; i<n; i++){
+		arr[i] = (int)(2 * i);
+	}
+	t0 = now();
+	stree_build_index(&t);
+	build = now() - t0;
+	b = malloc((n + 1) * sizeof(int));
+	if(b == NULL){
+		stree_free(&t);
+		free(queries);
+		return -1;
+	}
+	eytzinger_fill(arr, b, n, 0, 1);
+	for(q=0; q<nq; q++){
+		queries[q] = (int)(next_rand() % (2 * n + 2));
+	}
+
+	t0 = now();
+	for(q=0, check=0; q<nq; q++){
+		check += lower_bound_branchless(arr, n, queries[q]);
+	}
+	printf("%10lu %9luK %10.2f", (unsigned long)n, (unsigned long)(n * sizeof(int) >> 10), nq / (now() - t0) / 1e6);
+
+	//compare by value: arr[i] is 2 * i, and 2 * n stands for "none"
+	t0 = now();
+	for(q=0, sum=0; q<nq; q++){
+		i = eytzinger_lower_bound(b, n, queries[q]);
+		sum += (i == 0) ? 2 * n : (size_t)b[i];
+	}
+	printf(" %10.2f", nq / (now() - t0) / 1e6);
+	bad = (sum != 2 * check);
+
+	t0 = now();
+	for(q=0, sum=0; q<nq; q++){
+		sum += stree_lower_bound(&t, queries[q]);
+	}
+	bad += (sum != check);
+	printf(" %10.2f %8.1f ms %5.1f%%%s\n", nq / (now() - t0) / 1e6, build * 1e3,
+		100.0 * (stree_bytes(&t) - n * sizeof(int)) / (n * sizeof(int)), bad ? "  MISMATCH" : "");
+	stree_free(&t);
+	free(b);
+	free(queries);
+	return 0;
+}
+
+int main(int argc, char **argv){
+	size_t big = (argc > 1) ? strtoull(argv[1], NULL, 10) : 1000000000;
+	size_t nq = 1000000, i, q, sum, check;
+	int arr_demo[] = {3,5,7,8,10}, *arr, *queries;
+	stree_t t;
+	double t0, fill;
+	int lg;
+
+	if(stree_build(&t, arr_demo, 5) != 0){
+		return 1;
+	}
+	printf("lower bound of 8 is index %lu, of 11 is %lu\n", (unsigned long)stree_lower_bound(&t, 8),
+		(unsigned long)stree_lower_bound(&t, 11));
+	stree_free(&t);
+
+	printf("Mlookups/s, %lu random lookups per size; build is the index above the sorted keys\n", (unsigned long)nq);
+	printf("%10s %10s %10s %10s %10s %11s %6s\n", "n", "bytes", "binary", "eytzinger", "s-tree", "build", "extra");
+	for(lg=10; lg<=27; lg+=3){
+		if(bench_layouts((size_t)1 << lg, nq) != 0){
+			break;
+		}
+	}
+
+	//bulk build at the large size; there is only room for the tree itself,
+	//so binary search runs on its bottom layer, which is the sorted array
+	if(big > (size_t)INT_MAX / 2 || stree_init(&t, big) != 0){
+		printf("no memory for %lu keys\n", (unsigned long)big);
+		return 1;
+	}
+	queries = malloc(nq * sizeof(int));
+	if(queries == NULL){
+		stree_free(&t);
+		return 1;
+	}
+	arr = stree_leaves(&t);
+	t0 = now();
+	for(i=0; i<big; i++){
+		arr[i] = (int)(2 * i);
+	}
+	fill = now() - t0;
+	t0 = now();
+	stree_build_index(&t);
+	printf("%lu keys (%.2f GB with index, %d layers): fill %.2f s, build %.2f s\n", (unsigned long)big,
+		stree_bytes(&t) / 1e9, t.height, fill, now() - t0);
+	for(q=0; q<nq; q++){
+		queries[q] = (int)(next_rand() % (2 * big + 2));
+	}
+	t0 = now();
+	for(q=0, check=0; q<nq; q++){
+		check += lower_bound_branchless(arr, big, queries[q]);
+	}
+	printf("  binary %.2f Mlookups/s,", nq / (now() - t0) / 1e6);
+	t0 = now();
+	for(q=0, sum=0; q<nq; q++){
+		sum += stree_lower_bound(&t, queries[q]);
+	}
+	printf(" s-tree %.2f Mlookups/s%s\n", nq / (now() - t0) / 1e6, (sum != check) ? "  MISMATCH" : "");
+	stree_free(&t);
+	free(queries);
+	return 0;
+}
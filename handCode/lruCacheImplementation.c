@@ -0,0 +1,462 @@
+// lruCacheImplementation
+// Fixed-size key/value cache with O(1) get and put and three eviction
+// policies:
+//  - LRU: a doubly-linked recency list. A hit moves its node to the front
+//    and the back is evicted.
+//  - CLOCK: no list moves on a hit, only a reference bit is set. A hand
+//    sweeps the slots, clearing bits, and evicts the first clear one.
+//  - S3-FIFO: a small FIFO (10%) for new keys and a main FIFO for keys
+//    that were hit while in the small one, plus a ghost list of keys
+//    recently dropped from the small FIFO. One-hit wonders leave through
+//    the small FIFO without pushing anything out of main.
+// The lists are intrusive: the links live in the nodes, and they are node
+// indices, not pointers, so the list needs no allocation. All nodes come
+// from one pool allocated up front, sized from a memory budget, so the
+// cache never calls malloc after cache_init. Keys are strings of up to
+// KEY_MAX - 1 bytes stored in the node, and the index is a linear-probing
+// table of node indices keyed by djb2.
+// main() replays Zipf traces and reports hit ratio and operations per
+// second for each policy.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define KEY_MAX 32
+#define SMALL_LIST 0		// node 0 heads the LRU list or the S3-FIFO small FIFO
+#define MAIN_LIST 1		// node 1 heads the S3-FIFO main FIFO
+#define FIRST_NODE 2
+#define MAX_FREQ 3
+
+typedef enum cache_policy{
+	POLICY_LRU,
+	POLICY_CLOCK,
+	POLICY_S3FIFO
+} cache_policy_t;
+
+typedef struct cache_node{
+	unsigned int prev, next;	// list links, as node indices
+	unsigned long long hash;
+	int val;
+	unsigned char freq;		// CLOCK reference bit, S3-FIFO hit count
+	unsigned char list;		// S3-FIFO: SMALL_LIST or MAIN_LIST
+	char key[KEY_MAX];
+} cache_node_t;
+
+typedef struct cache{
+	cache_policy_t policy;
+	cache_node_t *nodes;		// two list heads, then capacity nodes
+	unsigned int capacity, used;
+	unsigned int free_list;		// unused pool nodes, chained by next, 0 if none
+	unsigned int *index;		// node index per slot, 0 is empty
+	size_t index_mask;
+	unsigned int hand;		// CLOCK
+	unsigned int small_count, small_cap;	// S3-FIFO
+	unsigned long long *ghost;	// S3-FIFO: hash and time of dropped keys
+	unsigned long long *ghost_time;
+	size_t ghost_mask;
+	unsigned long long clock;
+	size_t hits, misses;
+} cache_t;
+
+// djb2HashImplementation.c, mixed so the low bits can index the table
+unsigned long djb2_hash(unsigned char *str){
+	unsigned long hash = 5381;
+	int c;
+
+	while((c = *str++)){
+		hash = ((hash << 5) + hash) + c;
+	}
+	return hash;
+}
+
+static unsigned long long key_hash(const char *key){
+	unsigned long long h = (unsigned long long)djb2_hash((unsigned char *)key) * 0x9E3779B97F4A7C15ULL;
+	return h ^ (h >> 29);
+}
+
+//intrusive list
+static void list_init(cache_t *c, unsigned int head){
+	c->nodes[head].prev = c->nodes[head].next = head;
+}
+
+static void list_unlink(cache_t *c, unsigned int i){
+	cache_node_t *n = &c->nodes[i];
+	c->nodes[n->prev].next = n->next;
+	c->nodes[n->next].prev = n->prev;
+}
+
+static void list_push_front(cache_t *c, unsigned int head, unsigned int i){
+	cache_node_t *n = &c->nodes[i];
+	n->prev = head;
+	n->next = c->nodes[head].next;
+	c->nodes[n->next].prev = i;
+	c->nodes[head].next = i;
+}
+
+static unsigned int list_back(const cache_t *c, unsigned int head){
+	return c->nodes[head].prev;
+}
+
+//index
+static size_t index_find(const cache_t *c, const char *key, unsigned long long h){
+	size_t pos;
+	unsigned int i;
+
+	for(pos=h & c->index_mask; (i = c->index[pos]) != 0; pos=(pos + 1) & c->index_mask){
+		if(c->nodes[i].hash == h && strcmp(c->nodes[i].key, key) == 0){
+			return pos;
+		}
+	}
+	return pos;
+}
+
+// Linear probing without tombstones: pull later entries of the run back
+// into the hole so every entry stays reachable from its home slot
+static void index_remove(cache_t *c, size_t pos){
+	size_t hole = pos, home;
+	unsigned int i;
+
+	c->index[hole] = 0;
+	for(pos=(pos + 1) & c->index_mask; (i = c->index[pos]) != 0; pos=(pos + 1) & c->index_mask){
+		home = c->nodes[i].hash & c->index_mask;
+		//move it if its home is not in (hole, pos]
+		if(((pos - home) & c->index_mask) >= ((pos - hole) & c->index_mask)){
+			c->index[hole] = i;
+			c->index[pos] = 0;
+			hole = pos;
+		}
+	}
+}
+
+static void index_remove_node(cache_t *c, unsigned int i){
+	index_remove(c, index_find(c, c->nodes[i].key, c->nodes[i].hash));
+}
+
+//ghost
+static void ghost_add(cache_t *c, unsigned long long h){
+	size_t slot = h & c->ghost_mask;
+	c->ghost[slot] = h;
+	c->ghost_time[slot] = ++c->clock;
+}
+
+// Whether h was dropped within the last capacity evictions. A newer key
+// with the same slot can push it out early, which only costs a little
+// hit ratio.
+static int ghost_take(cache_t *c, unsigned long long h){
+	size_t slot = h & c->ghost_mask;
+
+	if(c->ghost[slot] == h && c->clock - c->ghost_time[slot] < c->capacity){
+		c->ghost[slot] = 0;
+		return 1;
+	}
+	return 0;
+}
+
+// Bytes needed for capacity entries
+static size_t cache_bytes(cache_policy_t policy, size_t capacity, size_t *index_slots, size_t *ghost_slots){
+	size_t is = 1, gs = 1;
+
+	while(is < capacity * 2){
+		is <<= 1;
+	}
+	while(policy == POLICY_S3FIFO && gs < capacity){
+		gs <<= 1;
+	}
+	*index_slots = is;
+	*ghost_slots = (policy == POLICY_S3FIFO) ? gs : 0;
+	return (capacity + FIRST_NODE) * sizeof(cache_node_t) + is * sizeof(unsigned int)
+		+ *ghost_slots * 2 * sizeof(unsigned long long);
+}
+
+// As many entries as fit in budget bytes. Returns -1 if that is none or
+// out of memory.
+int cache_init(cache_t *c, cache_policy_t policy, size_t budget){
+	size_t capacity = budget / sizeof(cache_node_t), is, gs, i;
+
+	memset(c, 0, sizeof(*c));
+	while(capacity > 0 && cache_bytes(policy, capacity, &is, &gs) > budget){
+		capacity -= capacity / 64 + 1;
+	}
+	if(capacity == 0 || capacity > 0xFFFFFFF0u){
+		return -1;
+	}
+	c->policy = policy;
+	c->capacity = (unsigned int)capacity;
+	c->nodes = malloc((capacity + FIRST_NODE) * sizeof(cache_node_t));
+	c->index = calloc(is, sizeof(unsigned int));
+	c->index_mask = is - 1;
+	if(gs){
+		c->ghost = calloc(gs, sizeof(unsigned long long));
+		c->ghost_time = calloc(gs, sizeof(unsigned long long));
+		c->ghost_mask = gs - 1;
+	}
+	if(c->nodes == NULL || c->index == NULL || (gs && (c->ghost == NULL || c->ghost_time == NULL))){
+		free(c->nodes);
+		free(c->index);
+		free(c->ghost);
+		free(c->ghost_time);
+		return -1;
+	}
+	list_init(c, SMALL_LIST);
+	list_init(c, MAIN_LIST);
+	for(i=FIRST_NODE; i<capacity + FIRST_NODE; i++){
+		c->nodes[i].next = (i + 1 < capacity + FIRST_NODE) ? (unsigned int)i + 1 : 0;
+	}
+	c->free_list = FIRST_NODE;
+	c->hand = FIRST_NODE;
+	c->small_cap = (c->capacity / 10 > 0) ? c->capacity / 10 : 1;
+	return 0;
+}
+
+void cache_free(cache_t *c){
+	free(c->nodes);
+	free(c->index);
+	free(c->ghost);
+	free(c->ghost_time);
+	memset(c, 0, sizeof(*c));
+}
+
+// Returns 1 and stores the value in *val on a hit, 0 on a miss
+int cache_get(cache_t *c, const char *key, int *val){
+	unsigned long long h = key_hash(key);
+	unsigned int i = c->index[index_find(c, key, h)];
+	cache_node_t *n;
+
+	if(i == 0){
+		c->misses++;
+		return 0;
+	}
+	c->hits++;
+	n = &c->nodes[i];
+	switch(c->policy){
+	case POLICY_LRU:
+		list_unlink(c, i);
+		list_push_front(c, SMALL_LIST, i);
+		break;
+	case POLICY_CLOCK:
+		n->freq = 1;
+		break;
+	case POLICY_S3FIFO:
+		if(n->freq < MAX_FREQ){
+			n->freq++;
+		}
+		break;
+	}
+	if(val != NULL){
+		*val = n->val;
+	}
+	return 1;
+}
+
+// S3-FIFO eviction. The small FIFO gives up its oldest key, which moves
+// to main if it was hit more than once; main gives its oldest key another
+// round for each hit it had.
+static unsigned int s3fifo_evict(cache_t *c){
+	unsigned int i;
+	cache_node_t *n;
+
+	for(;;){
+		if(c->small_count > c->small_cap || c->nodes[MAIN_LIST].next == MAIN_LIST){
+			i = list_back(c, SMALL_LIST);
+			n = &c->nodes[i];
+			list_unlink(c, i);
+			c->small_count--;
+			if(n->freq > 1){
+				n->freq = 0;
+				n->list = MAIN_LIST;
+				list_push_front(c, MAIN_LIST, i);
+				continue;
+			}
+			ghost_add(c, n->hash);
+			return i;
+		}
+		i = list_back(c, MAIN_LIST);
+		n = &c->nodes[i];
+		list_unlink(c, i);
+		if(n->freq > 0){
+			n->freq--;
+			list_push_front(c, MAIN_LIST, i);
+			continue;
+		}
+		return i;
+	}
+}
+
+// A free node, evicting one when the pool is used up. The node is out of
+// the index and off every list.
+static unsigned int cache_take_node(cache_t *c){
+	unsigned int i;
+
+	if(c->free_list != 0){
+		i = c->free_list;
+		c->free_list = c->nodes[i].next;
+		c->used++;
+		return i;
+	}
+	switch(c->policy){
+	case POLICY_LRU:
+		i = list_back(c, SMALL_LIST);
+		list_unlink(c, i);
+		break;
+	case POLICY_CLOCK:
+		while(c->nodes[c->hand].freq){
+			c->nodes[c->hand].freq = 0;
+			c->hand = (c->hand + 1 < c->capacity + FIRST_NODE) ? c->hand + 1 : FIRST_NODE;
+		}
+		i = c->hand;
+		c->hand = (c->hand + 1 < c->capacity + FIRST_NODE) ? c->hand + 1 : FIRST_NODE;
+		break;
+	default:
+		i = s3fifo_evict(c);
+		break;
+	}
+	index_remove_node(c, i);
+	return i;
+}
+
+// Insert or update. Returns -1 if the key is too long.
+int cache_put(cache_t *c, const char *key, int val){
+	unsigned long long h = key_hash(key);
+	size_t len = strlen(key), pos = index_find(c, key, h);
+	unsigned int i = c->index[pos];
+	cache_node_t *n;
+
+	if(len >= KEY_MAX){
+		return -1;
+	}
+	if(i != 0){
+		c->nodes[i].val = val;
+		return 0;
+	}
+	i = cache_take_node(c);
+	//eviction may have moved entries around in the index
+	pos = index_find(c, key, h);
+	n = &c->nodes[i];
+	memcpy(n->key, key, len + 1);
+	n->hash = h;
+	n->val = val;
+	n->freq = 0;
+	c->index[pos] = i;
+	switch(c->policy){
+	case POLICY_LRU:
+		list_push_front(c, SMALL_LIST, i);
+		break;
+	case POLICY_CLOCK:
+		break;
+	case POLICY_S3FIFO:
+		if(ghost_take(c, h)){
+			n->list = MAIN_LIST;
+			list_push_front(c, MAIN_LIST, i);
+		}else{
+			n->list = SMALL_LIST;
+			list_push_front(c, SMALL_LIST, i);
+			c->small_count++;
+		}
+		break;
+	}
+	return 0;
+}
+
+//benchmark
+static const char *policy_name[] = {"LRU", "CLOCK", "S3-FIFO"};
+
+static char **zipf_trace(char **names, size_t items, size_t len, double alpha){
+	double *cdf = malloc(items * sizeof(*cdf)), total = 0, u;
+	char **trace = malloc(len * sizeof(*trace));
+	unsigned long long x = 0x9E3779B97F4A7C15ULL;
+	size_t i, lo, hi, mid;
+
+	if(cdf == NULL || trace == NULL){
+		free(cdf);
+		free(trace);
+		return NULL;
+	}
+	for(i=0; i<items; i++){
+		total += pow(i + 1.0, -alpha);
+		cdf[i] = total;
+	}
+	for(i=0; i<len; i++){
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		u = (double)(x >> 11) / 9007199254740992.0 * total;
+		for(lo=0, hi=items-1; lo<hi; ){
+			mid = (lo + hi) / 2;
+			if(cdf[mid] < u){
+				lo = mid + 1;
+			}else{
+				hi = mid;
+			}
+		}
+		trace[i] = names[lo];
+	}
+	free(cdf);
+	return trace;
+}
+
+int main(int argc, char **argv){
+	size_t items = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+	size_t len = (argc > 2) ? strtoul(argv[2], NULL, 10) : 10000000;
+	static const double alphas[] = {0.7, 0.9, 1.1};
+	static const size_t budgets[] = {1u << 20, 8u << 20};
+	char *buf = malloc(items * 24);
+	char **names = malloc(items * sizeof(*names)), **trace;
+	cache_t c;
+	size_t i;
+	clock_t start;
+	double sec;
+	int a, b, p, val;
+
+	if(buf == NULL || names == NULL){
+		return 1;
+	}
+	for(i=0; i<items; i++){
+		names[i] = buf + i * 24;
+		sprintf(names[i], "object:%lu", (unsigned long)(i * 2654435761u));
+	}
+
+	//small demo: capacity of a few entries, LRU order
+	cache_init(&c, POLICY_LRU, 4 * sizeof(cache_node_t) + 256);
+	cache_put(&c, "a", 1);
+	cache_put(&c, "b", 2);
+	for(i=0; i<c.capacity; i++){
+		cache_get(&c, "a", NULL);
+		cache_put(&c, names[i], (int)i);
+	}
+	printf("capacity %u: a %s, b %s\n", c.capacity, cache_get(&c, "a", &val) ? "kept" : "evicted",
+		cache_get(&c, "b", &val) ? "kept" : "evicted");
+	cache_free(&c);
+
+	printf("%lu items, %lu requests, look-aside: put on every miss\n", (unsigned long)items, (unsigned long)len);
+	printf("alpha  budget  policy    entries   hit ratio   Mops/s\n");
+	for(a=0; a<3; a++){
+		trace = zipf_trace(names, items, len, alphas[a]);
+		if(trace == NULL){
+			return 1;
+		}
+		for(b=0; b<2; b++){
+			for(p=POLICY_LRU; p<=POLICY_S3FIFO; p++){
+				if(cache_init(&c, (cache_policy_t)p, budgets[b]) != 0){
+					return 1;
+				}
+				start = clock();
+				for(i=0; i<len; i++){
+					if(!cache_get(&c, trace[i], &val)){
+						cache_put(&c, trace[i], (int)i);
+					}
+				}
+				sec = (double)(clock() - start) / CLOCKS_PER_SEC;
+				printf("%5.1f %5luMB  %-8s %8u %10.2f%% %8.2f\n", alphas[a], (unsigned long)(budgets[b] >> 20),
+					policy_name[p], c.capacity, 100.0 * c.hits / len, len / sec / 1e6);
+				cache_free(&c);
+			}
+		}
+		free(trace);
+	}
+	free(buf);
+	free(names);
+	return 0;
+}